@@ -0,0 +1,581 @@
+
+#include "benchmodels.h"
+#include "outlinegenerator.h"
+#include "legacytree.h"
+#include "treemodel.h"
+#include "filelistmodel.h"
+#include "scrollprefetcher.h"
+
+#include <QApplication>
+#include <QTreeView>
+#include <QScrollBar>
+#include <QTest>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QDir>
+#include <QQueue>
+
+#if defined( __GLIBC__ )
+#include <malloc.h>
+#endif
+
+namespace
+{
+    const int kOutlineSizes[] = { 1000, 10000, 100000, 1000000, 10000000 };
+    const int kFileCounts[] = { 1000, 10000, 100000 };
+    const int kAccessLines = 100000;
+    const int kLegacyMaxLines = 1000000; // the old layout needs a few GB beyond this
+    const int kWaitMS = 10 * 60 * 1000;
+
+    // a steady downward scroll of about 1200 rows a second
+    const int kStallLines[] = { 100000, 1000000 };
+    const int kScrollFrames = 300;
+    const int kFrameMS = 16;
+    const int kRowsPerFrame = 20;
+
+    // fan-out and depth pairs for the access benchmarks, from a chain to a flat list
+    const struct { int fanOut; int depth; } kShapes[] = { { 1, 32 }, { 2, 16 }, { 10, 5 }, { 100, 3 }, { 10000, 2 }, { kAccessLines, 1 } };
+
+    const char * modeName( TreeModel::ELoadMode mode )
+    {
+        switch ( mode )
+        {
+            case TreeModel::ELoadMode::eImmediate: return "immediate";
+            case TreeModel::ELoadMode::eBackground: return "background";
+            case TreeModel::ELoadMode::eLazy: return "lazy";
+            case TreeModel::ELoadMode::eParallel: return "parallel";
+        }
+        return "";
+    }
+
+    bool load( TreeModel & model, const QByteArray & data, TreeModel::ELoadMode mode )
+    {
+        if ( mode != TreeModel::ELoadMode::eBackground )
+        {
+            model.load( data, mode );
+            return true;
+        }
+
+        QSignalSpy spy( &model, &TreeModel::loadFinished );
+        model.load( data, mode );
+        return spy.wait( kWaitMS );
+    }
+
+    // the way a view gets there, one fetchMore batch at a time
+    void fetchAll( QAbstractItemModel & model )
+    {
+        QQueue< QModelIndex > parents;
+        parents.enqueue( QModelIndex() );
+        while ( !parents.isEmpty() )
+        {
+            auto parent = parents.dequeue();
+            while ( model.canFetchMore( parent ) )
+            {
+                auto before = model.rowCount( parent );
+                model.fetchMore( parent );
+                if ( model.rowCount( parent ) == before )
+                    break;
+            }
+            for ( int ii = 0; ii < model.rowCount( parent ); ++ii )
+                parents.enqueue( model.index( ii, 0, parent ) );
+        }
+    }
+
+    QModelIndexList allIndexes( const QAbstractItemModel & model )
+    {
+        QModelIndexList retVal;
+        QQueue< QModelIndex > parents;
+        parents.enqueue( QModelIndex() );
+        while ( !parents.isEmpty() )
+        {
+            auto parent = parents.dequeue();
+            for ( int ii = 0; ii < model.rowCount( parent ); ++ii )
+            {
+                auto index = model.index( ii, 0, parent );
+                retVal << index;
+                parents.enqueue( index );
+            }
+        }
+        return retVal;
+    }
+
+    // a blank and a tab only line before every top level line, so wherever a
+    // parallel chunk boundary lands it has them right before it
+    QByteArray withBlankLines( const QByteArray & data )
+    {
+        QByteArray retVal;
+        retVal.reserve( data.size() * 2 );
+        for ( int pos = 0; pos < data.size(); )
+        {
+            auto end = data.indexOf( '\n', pos );
+            end = ( end < 0 ) ? data.size() : ( end + 1 );
+            if ( ( data[ pos ] != '\t' ) && ( data[ pos ] != '\n' ) )
+                retVal.append( "\n\t\t\n" );
+            retVal.append( data.constData() + pos, end - pos );
+            pos = end;
+        }
+        return retVal;
+    }
+
+    // the top level rows with their ": row" suffix, which the parallel chunks must number as the serial parse does
+    QStringList topLevelRows( TreeModel & model )
+    {
+        model.fetchSubtree( QModelIndex(), 1 );
+        QStringList retVal;
+        for ( int ii = 0; ii < model.rowCount(); ++ii )
+            retVal << model.data( model.index( ii, 0 ) ).toString();
+        return retVal;
+    }
+
+    // bytes malloc has handed out and not had back, over every thread's arena; -1 where unknown
+    qint64 heapInUse()
+    {
+#if defined( __GLIBC__ ) && __GLIBC_PREREQ( 2, 33 )
+        auto info = mallinfo2();
+        return static_cast< qint64 >( info.uordblks + info.hblkhd );
+#else
+        return -1;
+#endif
+    }
+
+    int envLimit( const char * name, int defaultValue )
+    {
+        bool aOK = false;
+        auto retVal = qEnvironmentVariableIntValue( name, &aOK );
+        return aOK ? retVal : defaultValue;
+    }
+}
+
+BenchModels::BenchModels()
+{
+    fMaxLines = envLimit( "FETCHMORE_BENCH_MAX_LINES", 10000000 );
+    fMaxFiles = envLimit( "FETCHMORE_BENCH_MAX_FILES", 10000 );
+}
+
+BenchModels::~BenchModels()
+{
+}
+
+void BenchModels::initTestCase()
+{
+    QFile file( ":/default.txt" );
+    QVERIFY( file.open( QIODevice::ReadOnly ) );
+    fSeed = file.readAll();
+    QVERIFY( !fSeed.isEmpty() );
+}
+
+void BenchModels::addSizes()
+{
+    QTest::addColumn< int >( "lines" );
+    QTest::addColumn< int >( "mode" );
+    for ( auto && lines : kOutlineSizes )
+    {
+        if ( lines > fMaxLines )
+            break;
+        for ( auto mode : { TreeModel::ELoadMode::eImmediate, TreeModel::ELoadMode::eBackground, TreeModel::ELoadMode::eLazy, TreeModel::ELoadMode::eParallel } )
+            QTest::addRow( "%s %d lines", modeName( mode ), lines ) << lines << static_cast< int >( mode );
+    }
+}
+
+void BenchModels::addFileCounts()
+{
+    QTest::addColumn< int >( "files" );
+    for ( auto && files : kFileCounts )
+    {
+        if ( files > fMaxFiles )
+            break;
+        QTest::addRow( "%d files", files ) << files;
+    }
+}
+
+// default.txt repeated, generated once per size for the whole run
+QByteArray BenchModels::outline( int lines )
+{
+    auto pos = fOutlines.find( lines );
+    if ( pos == fOutlines.end() )
+        pos = fOutlines.insert( lines, NOutlineGenerator::repeat( fSeed, lines ) );
+    return pos.value();
+}
+
+// outline( lines ) on disk, loadFile is the only way to a snapshot
+QString BenchModels::outlineFile( int lines )
+{
+    if ( !fOutlineDir )
+        fOutlineDir = std::make_unique< QTemporaryDir >();
+    auto path = fOutlineDir->filePath( QString( "outline_%1.txt" ).arg( lines ) );
+    if ( !QFile::exists( path ) )
+    {
+        QFile file( path );
+        file.open( QIODevice::WriteOnly );
+        file.write( outline( lines ) );
+    }
+    return path;
+}
+
+QString BenchModels::directory( int files )
+{
+    auto pos = fDirectories.find( files );
+    if ( pos == fDirectories.end() )
+    {
+        auto dir = std::make_shared< QTemporaryDir >();
+        for ( int ii = 0; ii < files; ++ii )
+        {
+            QFile file( dir->filePath( QString( "file_%1.txt" ).arg( ii, 6, 10, QChar( '0' ) ) ) );
+            file.open( QIODevice::WriteOnly );
+        }
+        pos = fDirectories.insert( files, dir );
+    }
+    return pos.value()->path();
+}
+
+void BenchModels::parse_data()
+{
+    addSizes();
+}
+
+// load until the model can show its first rows: a complete tree that is not
+// shown yet, or for eLazy only the line index
+void BenchModels::parse()
+{
+    QFETCH( int, lines );
+    QFETCH( int, mode );
+    auto data = outline( lines );
+
+    TreeModel model;
+    QBENCHMARK
+    {
+        QVERIFY( load( model, data, static_cast< TreeModel::ELoadMode >( mode ) ) );
+    }
+
+    if ( static_cast< TreeModel::ELoadMode >( mode ) != TreeModel::ELoadMode::eParallel )
+        return;
+    for ( auto && text : { data, withBlankLines( data ) } )
+    {
+        TreeModel serial;
+        serial.load( text, TreeModel::ELoadMode::eImmediate );
+        TreeModel parallel;
+        parallel.load( text, TreeModel::ELoadMode::eParallel );
+        QCOMPARE( topLevelRows( parallel ), topLevelRows( serial ) );
+    }
+}
+
+void BenchModels::access_data()
+{
+    QTest::addColumn< QString >( "call" );
+    QTest::addColumn< int >( "fanOut" );
+    QTest::addColumn< int >( "depth" );
+    for ( auto && call : { "index", "parent", "rowCount", "data" } )
+    {
+        for ( auto && shape : kShapes )
+            QTest::addRow( "%s fan-out %d depth %d", call, shape.fanOut, shape.depth ) << QString( call ) << shape.fanOut << shape.depth;
+    }
+}
+
+// one call for every node of a fully shown tree per iteration, divide by the node count for the latency
+void BenchModels::access()
+{
+    QFETCH( QString, call );
+    QFETCH( int, fanOut );
+    QFETCH( int, depth );
+
+    TreeModel model;
+    model.load( NOutlineGenerator::balanced( qMin( kAccessLines, fMaxLines ), fanOut, depth ) );
+    model.fetchSubtree();
+    auto indexes = allIndexes( model );
+    QVector< QModelIndex > parents;
+    for ( auto && index : indexes )
+        parents << index.parent();
+
+    qint64 sink = 0;
+    if ( call == "index" )
+    {
+        QBENCHMARK
+        {
+            for ( int ii = 0; ii < indexes.count(); ++ii )
+                sink += model.index( indexes[ ii ].row(), 0, parents[ ii ] ).row();
+        }
+    }
+    else if ( call == "parent" )
+    {
+        QBENCHMARK
+        {
+            for ( auto && index : indexes )
+                sink += model.parent( index ).row();
+        }
+    }
+    else if ( call == "rowCount" )
+    {
+        QBENCHMARK
+        {
+            for ( auto && index : indexes )
+                sink += model.rowCount( index );
+        }
+    }
+    else
+    {
+        QBENCHMARK
+        {
+            for ( auto && index : indexes )
+                sink += model.data( index, Qt::DisplayRole ).toString().size();
+        }
+    }
+    QVERIFY( sink != -1 );
+}
+
+void BenchModels::fetchToFull_data()
+{
+    addSizes();
+}
+
+// from a loaded model to every row shown, one fetchMore batch at a time as a view would
+void BenchModels::fetchToFull()
+{
+    QFETCH( int, lines );
+    QFETCH( int, mode );
+
+    TreeModel model;
+    QVERIFY( load( model, outline( lines ), static_cast< TreeModel::ELoadMode >( mode ) ) );
+    QBENCHMARK_ONCE
+    {
+        fetchAll( model );
+    }
+}
+
+void BenchModels::fetchSubtree_data()
+{
+    addSizes();
+}
+
+// the same with one insert per parent the model had already shown
+void BenchModels::fetchSubtree()
+{
+    QFETCH( int, lines );
+    QFETCH( int, mode );
+
+    TreeModel model;
+    QVERIFY( load( model, outline( lines ), static_cast< TreeModel::ELoadMode >( mode ) ) );
+    QBENCHMARK_ONCE
+    {
+        model.fetchSubtree();
+    }
+}
+
+void BenchModels::memoryPerNode_data()
+{
+    addSizes();
+    for ( auto && lines : kOutlineSizes )
+    {
+        if ( lines > qMin( fMaxLines, kLegacyMaxLines ) )
+            break;
+        QTest::addRow( "before the arena %d lines", lines ) << lines << -1;
+    }
+}
+
+// Heap bytes per outline line once everything is shown, including the source
+// copy and the strings. The "before the arena" rows build the old heap
+// allocated TreeItem layout from NLegacyTree instead of a TreeModel.
+void BenchModels::memoryPerNode()
+{
+    QFETCH( int, lines );
+    QFETCH( int, mode );
+    if ( heapInUse() < 0 )
+        QSKIP( "heap usage is only measured with glibc" );
+
+    auto data = outline( lines );
+    auto before = heapInUse();
+    qint64 after = 0;
+    if ( mode < 0 )
+    {
+        auto root = NLegacyTree::build( data );
+        after = heapInUse();
+    }
+    else
+    {
+        TreeModel model;
+        QVERIFY( load( model, data, static_cast< TreeModel::ELoadMode >( mode ) ) );
+        model.fetchSubtree();
+        after = heapInUse();
+    }
+    QTest::setBenchmarkResult( static_cast< qreal >( after - before ) / lines, QTest::BytesAllocated );
+}
+
+void BenchModels::teardown_data()
+{
+    addSizes();
+}
+
+void BenchModels::teardown()
+{
+    QFETCH( int, lines );
+    QFETCH( int, mode );
+
+    auto model = std::make_unique< TreeModel >();
+    QVERIFY( load( *model, outline( lines ), static_cast< TreeModel::ELoadMode >( mode ) ) );
+    model->fetchSubtree();
+
+    QElapsedTimer timer;
+    timer.start();
+    model.reset();
+    QTest::setBenchmarkResult( timer.nsecsElapsed() / 1000000.0, QTest::WalltimeMilliseconds );
+}
+
+void BenchModels::reopen_data()
+{
+    addSizes();
+}
+
+// loadFile of an unchanged outline with a snapshot from an earlier load, compare with parse
+void BenchModels::reopen()
+{
+    QFETCH( int, lines );
+    QFETCH( int, mode );
+    auto path = outlineFile( lines );
+
+    TreeModel model;
+    model.setSnapshotDirectory( fOutlineDir->filePath( "snapshots" ) );
+    {
+        TreeModel first;
+        first.setSnapshotDirectory( model.snapshotDirectory() );
+        QVERIFY( first.loadFile( path, TreeModel::ELoadMode::eLazy ) );
+        first.fetchMore( QModelIndex() );
+    }
+
+    QBENCHMARK
+    {
+        QVERIFY( model.loadFile( path, static_cast< TreeModel::ELoadMode >( mode ) ) );
+    }
+    QVERIFY( model.isFromSnapshot() );
+    QVERIFY( model.rowCount() > 0 );
+}
+
+void BenchModels::reload_data()
+{
+    addSizes();
+}
+
+// a shown model reloading the same outline with one top level subtree inserted in the middle
+void BenchModels::reload()
+{
+    QFETCH( int, lines );
+    QFETCH( int, mode );
+    auto data = outline( lines );
+    auto middle = data.indexOf( "\n", data.size() / 2 ) + 1;
+    while ( ( middle > 0 ) && ( middle < data.size() ) && ( data[ middle ] == '\t' ) )
+        middle = data.indexOf( "\n", middle ) + 1; // the start of a top level line
+    auto changed = data.left( middle ) + "Inserted\tby the reload benchmark\n\tand its child\n" + data.mid( middle );
+
+    TreeModel model;
+    QVERIFY( load( model, data, static_cast< TreeModel::ELoadMode >( mode ) ) );
+    fetchAll( model );
+    bool toChanged = true;
+    QBENCHMARK
+    {
+        model.reload( toChanged ? changed : data );
+        toChanged = !toChanged;
+    }
+}
+
+void BenchModels::listDirectory_data()
+{
+    addFileCounts();
+}
+
+// a full enumeration every time, the listing cache is off
+void BenchModels::listDirectory()
+{
+    QFETCH( int, files );
+    auto path = directory( files );
+
+    FileListModel model;
+    model.setListingCacheSize( 0 );
+    QBENCHMARK
+    {
+        QSignalSpy spy( &model, &FileListModel::directoryLoaded );
+        model.setDirPath( path );
+        QVERIFY( !spy.isEmpty() || spy.wait( kWaitMS ) );
+    }
+}
+
+void BenchModels::listFetchToFull_data()
+{
+    addFileCounts();
+}
+
+// every iteration starts from the cached listing with nothing shown
+void BenchModels::listFetchToFull()
+{
+    QFETCH( int, files );
+    auto path = directory( files );
+
+    FileListModel model;
+    {
+        QSignalSpy spy( &model, &FileListModel::directoryLoaded );
+        model.setDirPath( path );
+        QVERIFY( !spy.isEmpty() || spy.wait( kWaitMS ) );
+    }
+
+    QAbstractItemModel & base = model;
+    QBENCHMARK
+    {
+        model.setDirPath( path );
+        while ( base.canFetchMore( QModelIndex() ) )
+            base.fetchMore( QModelIndex() );
+    }
+    // the listing keeps "." and "..", as QDir::entryList does
+    QCOMPARE( model.rowCount(), QDir( path ).entryList( QDir::AllEntries ).count() );
+}
+
+void BenchModels::scrollStalls_data()
+{
+    QTest::addColumn< int >( "lines" );
+    QTest::addColumn< bool >( "prefetch" );
+    for ( auto && lines : kStallLines )
+    {
+        if ( lines > fMaxLines )
+            break;
+        QTest::addRow( "no prefetch %d lines", lines ) << lines << false;
+        QTest::addRow( "prefetch %d lines", lines ) << lines << true;
+    }
+}
+
+// ScrollPrefetcher stalls while an offscreen view scrolls down at a steady
+// speed, the view's own end of list fetch is all there is without prefetching
+void BenchModels::scrollStalls()
+{
+    QFETCH( int, lines );
+    QFETCH( bool, prefetch );
+
+    TreeModel model;
+    QVERIFY( load( model, outline( lines ), TreeModel::ELoadMode::eImmediate ) );
+
+    QTreeView view;
+    view.resize( 800, 600 );
+    view.setVerticalScrollMode( QAbstractItemView::ScrollPerItem );
+    auto prefetcher = new ScrollPrefetcher( &view );
+    prefetcher->setEnabled( prefetch );
+    view.setModel( &model );
+    view.show();
+    QVERIFY( QTest::qWaitForWindowExposed( &view ) );
+
+    auto scrollBar = view.verticalScrollBar();
+    for ( int ii = 0; ii < kScrollFrames; ++ii )
+    {
+        scrollBar->setValue( scrollBar->value() + kRowsPerFrame );
+        QTest::qWait( kFrameMS );
+    }
+    QTest::setBenchmarkResult( prefetcher->stallCount(), QTest::Events );
+}
+
+int main( int argc, char * argv[] )
+{
+    if ( !qEnvironmentVariableIsSet( "QT_QPA_PLATFORM" ) )
+        qputenv( "QT_QPA_PLATFORM", "offscreen" );
+
+    Q_INIT_RESOURCE( simpletreemodel );
+    QApplication app( argc, argv );
+
+    BenchModels bench;
+    return QTest::qExec( &bench, argc, argv );
+}
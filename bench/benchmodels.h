@@ -0,0 +1,77 @@
+
+#ifndef BENCHMODELS_H
+#define BENCHMODELS_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+#include <memory>
+
+class QTemporaryDir;
+
+// Headless QBENCHMARK suite for TreeModel and FileListModel.
+// FETCHMORE_BENCH_MAX_LINES caps the outline sizes (default 10M lines),
+// FETCHMORE_BENCH_MAX_FILES the directory sizes (default 10k files).
+// scrollStalls drives a QTreeView, on the offscreen platform unless QT_QPA_PLATFORM says otherwise.
+class BenchModels : public QObject
+{
+    Q_OBJECT
+
+public:
+    BenchModels();
+    ~BenchModels();
+
+private slots:
+    void initTestCase();
+
+    void parse_data();
+    void parse();
+
+    void access_data();
+    void access();
+
+    void fetchToFull_data();
+    void fetchToFull();
+
+    void fetchSubtree_data();
+    void fetchSubtree();
+
+    void memoryPerNode_data();
+    void memoryPerNode();
+
+    void teardown_data();
+    void teardown();
+
+    void reopen_data();
+    void reopen();
+
+    void reload_data();
+    void reload();
+
+    void listDirectory_data();
+    void listDirectory();
+
+    void listFetchToFull_data();
+    void listFetchToFull();
+
+    void scrollStalls_data();
+    void scrollStalls();
+
+private:
+    void addSizes();
+    void addFileCounts();
+    QByteArray outline( int lines );
+    QString directory( int files );
+    QString outlineFile( int lines );
+
+    QByteArray fSeed; // default.txt
+    int fMaxLines;
+    int fMaxFiles;
+    QHash< int, QByteArray > fOutlines;
+    QHash< int, std::shared_ptr< QTemporaryDir > > fDirectories;
+    std::unique_ptr< QTemporaryDir > fOutlineDir; // outline files and their snapshots
+};
+
+#endif
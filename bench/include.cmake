@@ -0,0 +1,47 @@
+set(qtproject_SRCS
+    benchmodels.cpp
+    outlinegenerator.cpp
+    legacytree.cpp
+    ../main/treeitem.cpp
+    ../main/treemodel.cpp
+    ../main/filelistmodel.cpp
+    ../main/fetchpolicy.cpp
+    ../main/outlinescanner.cpp
+    ../main/outlineindex.cpp
+    ../main/outlinesnapshot.cpp
+    ../main/arena.cpp
+    ../main/stringtable.cpp
+    ../main/searchindex.cpp
+    ../main/modelstats.cpp
+    ../main/scrollprefetcher.cpp
+)
+
+set(qtproject_H
+   benchmodels.h
+   ../main/treemodel.h
+   ../main/filelistmodel.h
+   ../main/scrollprefetcher.h
+)
+
+set(project_H
+    outlinegenerator.h
+    legacytree.h
+    ../main/treeitem.h
+    ../main/fetchpolicy.h
+    ../main/outlinescanner.h
+    ../main/outlineindex.h
+    ../main/outlinesnapshot.h
+    ../main/arena.h
+    ../main/stringtable.h
+    ../main/searchindex.h
+    ../main/modelstats.h
+    ../main/evictablemodel.h
+)
+
+set(qtproject_UIS
+)
+
+
+set(qtproject_QRC
+    ../main/simpletreemodel.qrc
+)
@@ -0,0 +1,52 @@
+
+#include "legacytree.h"
+
+#include <QStringList>
+
+NLegacyTree::Item::Item( const QStringList & columns, Item * parentItem ) :
+    parent( parentItem )
+{
+    for ( auto && column : columns )
+        data << column;
+}
+
+NLegacyTree::Item::~Item()
+{
+    qDeleteAll( children );
+}
+
+std::unique_ptr< NLegacyTree::Item > NLegacyTree::build( const QByteArray & outline )
+{
+    auto root = std::make_unique< Item >( QStringList() << "Title" << "Summary", nullptr );
+    QList< Item * > parentStack;
+    parentStack << root.get();
+    auto prevItem = root.get();
+    int prevDepth = -1;
+    int topParentNum = 0;
+    for ( auto && currLine : QString::fromUtf8( outline ).split( QString( "\n" ) ) )
+    {
+        auto columns = currLine.split( "\t", Qt::KeepEmptyParts );
+        int depth = 0;
+        while ( !columns.isEmpty() && columns[ 0 ].isEmpty() )
+        {
+            depth++;
+            columns.pop_front();
+        }
+        columns.removeAll( QString() );
+        if ( columns.isEmpty() )
+            continue;
+
+        if ( depth > prevDepth )
+            parentStack.push_back( prevItem );
+        else if ( ( depth < prevDepth ) && ( parentStack.count() > 1 ) )
+            parentStack.pop_back();
+        auto parentItem = parentStack.back();
+        prevDepth = depth;
+
+        prevItem = new Item( columns, parentItem );
+        if ( parentStack.count() <= 2 )
+            prevItem->data[ 0 ] = prevItem->data[ 0 ].toString() + ": " + QString::number( topParentNum++ );
+        parentItem->children.append( prevItem );
+    }
+    return root;
+}
@@ -0,0 +1,30 @@
+
+#ifndef LEGACYTREE_H
+#define LEGACYTREE_H
+
+#include <QByteArray>
+#include <QList>
+#include <QVariant>
+
+#include <memory>
+
+// The TreeItem layout from before the arena, rebuilt in the bench only so
+// memoryPerNode has the old per node cost to compare against: one heap
+// allocation per item, a QList of children and a QList of QVariant columns,
+// filled by the original QString::split parse.
+namespace NLegacyTree
+{
+    struct Item
+    {
+        Item( const QStringList & columns, Item * parent );
+        ~Item();
+
+        QList< Item * > children;
+        QList< QVariant > data;
+        Item * parent{ nullptr };
+    };
+
+    std::unique_ptr< Item > build( const QByteArray & outline );
+}
+
+#endif
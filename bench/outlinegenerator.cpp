@@ -0,0 +1,62 @@
+
+#include "outlinegenerator.h"
+
+#include <limits>
+
+namespace
+{
+    const int kBytesPerLineEstimate = 48;
+
+    void appendSubtree( QByteArray & out, int & remaining, int & serial, int level, int fanOut, int depth )
+    {
+        if ( remaining <= 0 )
+            return;
+
+        auto number = QByteArray::number( serial++ );
+        out.append( QByteArray( level, '\t' ) );
+        out.append( "Node " ).append( number ).append( '\t' ).append( "Summary of node " ).append( number ).append( '\n' );
+        remaining--;
+
+        if ( level + 1 >= depth )
+            return;
+        for ( int ii = 0; ( ii < fanOut ) && ( remaining > 0 ); ++ii )
+            appendSubtree( out, remaining, serial, level + 1, fanOut, depth );
+    }
+}
+
+// the seed starts at the top level, so every copy joins on a valid line
+QByteArray NOutlineGenerator::repeat( const QByteArray & seed, int lineCount )
+{
+    QByteArray retVal;
+    if ( seed.count( '\n' ) == seed.size() )
+        return retVal;
+
+    retVal.reserve( static_cast< int >( qMin< qint64 >( static_cast< qint64 >( lineCount ) * kBytesPerLineEstimate, std::numeric_limits< int >::max() / 2 ) ) );
+    int lines = 0;
+    int pos = 0;
+    while ( lines < lineCount )
+    {
+        auto end = seed.indexOf( '\n', pos );
+        if ( end < 0 )
+            end = seed.size();
+        if ( end > pos )
+        {
+            retVal.append( seed.constData() + pos, end - pos ).append( '\n' );
+            lines++;
+        }
+        pos = ( end + 1 < seed.size() ) ? ( end + 1 ) : 0;
+    }
+    return retVal;
+}
+
+QByteArray NOutlineGenerator::balanced( int lineCount, int fanOut, int depth )
+{
+    QByteArray retVal;
+    retVal.reserve( static_cast< int >( qMin< qint64 >( static_cast< qint64 >( lineCount ) * kBytesPerLineEstimate, std::numeric_limits< int >::max() / 2 ) ) );
+
+    int remaining = lineCount;
+    int serial = 0;
+    while ( remaining > 0 )
+        appendSubtree( retVal, remaining, serial, 0, qMax( 1, fanOut ), qMax( 1, depth ) );
+    return retVal;
+}
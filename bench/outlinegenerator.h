@@ -0,0 +1,18 @@
+
+#ifndef OUTLINEGENERATOR_H
+#define OUTLINEGENERATOR_H
+
+#include <QByteArray>
+
+// Synthetic outlines in the tab indented format of default.txt
+namespace NOutlineGenerator
+{
+    // the seed repeated, and cut, until it has lineCount lines
+    QByteArray repeat( const QByteArray & seed, int lineCount );
+
+    // top level nodes each heading a full tree with fanOut children per node
+    // and depth levels in all, as many as fit in lineCount lines
+    QByteArray balanced( int lineCount, int fanOut, int depth );
+}
+
+#endif
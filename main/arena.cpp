@@ -0,0 +1,116 @@
+
+#include "arena.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    char * alignUp( char * ptr, size_t alignment )
+    {
+        auto value = reinterpret_cast< std::uintptr_t >( ptr );
+        return reinterpret_cast< char * >( ( value + alignment - 1 ) & ~( std::uintptr_t( alignment ) - 1 ) );
+    }
+}
+
+Arena::Arena( size_t blockSize ) :
+    fBlockSize( blockSize )
+{
+}
+
+Arena::~Arena()
+{
+    clear();
+}
+
+void * Arena::allocate( size_t size, size_t alignment )
+{
+    if ( !fFreeLists.isEmpty() )
+    {
+        auto pos = fFreeLists.find( size );
+        if ( ( pos != fFreeLists.end() ) && pos.value() && ( alignUp( static_cast< char * >( pos.value() ), alignment ) == pos.value() ) )
+        {
+            auto retVal = pos.value();
+            pos.value() = *static_cast< void ** >( retVal );
+            if ( !pos.value() )
+                fFreeLists.erase( pos );
+            fBytesReleased -= size;
+            return retVal;
+        }
+    }
+
+    fBytesUsed += size;
+
+    // big requests get a block of their own so the current block is not abandoned
+    if ( ( size + alignment ) > ( fBlockSize / 4 ) )
+        return alignUp( newBlock( size + alignment ), alignment );
+
+    auto aligned = fCurr ? alignUp( fCurr, alignment ) : nullptr;
+    if ( !aligned || ( ( aligned + size ) > fEnd ) )
+    {
+        fCurr = newBlock( fBlockSize );
+        fEnd = fCurr + fBlockSize;
+        aligned = alignUp( fCurr, alignment );
+    }
+    fCurr = aligned + size;
+    return aligned;
+}
+
+char * Arena::newBlock( size_t size )
+{
+    auto block = static_cast< char * >( std::malloc( size ) );
+    if ( !block )
+        throw std::bad_alloc();
+    fBlocks.append( block );
+    fBytesReserved += size;
+    return block;
+}
+
+// too small to hold the free list link, such allocations stay lost until clear()
+void Arena::release( void * memory, size_t size )
+{
+    if ( !memory || ( size < sizeof( void * ) ) )
+        return;
+
+    auto && head = fFreeLists[ size ];
+    *static_cast< void ** >( memory ) = head;
+    head = memory;
+    fBytesReleased += size;
+}
+
+// the absorbed blocks are only freed, allocation continues in this arena's current block
+void Arena::absorb( Arena & other )
+{
+    fBlocks += other.fBlocks;
+    fBytesReserved += other.fBytesReserved;
+    fBytesUsed += other.fBytesUsed;
+    for ( auto pos = other.fFreeLists.begin(); pos != other.fFreeLists.end(); ++pos )
+    {
+        for ( auto memory = pos.value(); memory; )
+        {
+            auto next = *static_cast< void ** >( memory );
+            release( memory, pos.key() );
+            memory = next;
+        }
+    }
+
+    other.fBlocks.clear();
+    other.fFreeLists.clear();
+    other.fCurr = other.fEnd = nullptr;
+    other.fBytesReserved = 0;
+    other.fBytesUsed = 0;
+    other.fBytesReleased = 0;
+}
+
+void Arena::clear()
+{
+    for ( auto && block : fBlocks )
+        std::free( block );
+    fBlocks.clear();
+    fFreeLists.clear();
+    fCurr = fEnd = nullptr;
+    fBytesReserved = 0;
+    fBytesUsed = 0;
+    fBytesReleased = 0;
+}
@@ -0,0 +1,51 @@
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <QVector>
+#include <QHash>
+#include <cstddef>
+
+// Bump allocator handing out memory from large blocks.
+// Addresses stay valid until clear(), which frees the blocks without running
+// any destructors, so only trivially destructible objects belong here.
+// Released allocations go on a free list per size and are handed out again
+// for a request of the same size, the blocks themselves are kept.
+class Arena
+{
+public:
+    explicit Arena( size_t blockSize = 64 * 1024 );
+    ~Arena();
+
+    Arena( const Arena & ) = delete;
+    Arena & operator=( const Arena & ) = delete;
+
+    void * allocate( size_t size, size_t alignment );
+    template< typename T >
+    T * allocate( size_t count = 1 )
+    {
+        return static_cast< T * >( allocate( sizeof( T ) * count, alignof( T ) ) );
+    }
+
+    void release( void * memory, size_t size ); // size as allocated
+    void clear();
+    void absorb( Arena & other ); // takes over other's blocks, other is left empty
+
+    int blockCount() const { return fBlocks.count(); }
+    qint64 bytesReserved() const { return fBytesReserved; }
+    qint64 bytesUsed() const { return fBytesUsed; }
+    qint64 bytesReleased() const { return fBytesReleased; } // on the free lists, part of bytesUsed
+private:
+    char * newBlock( size_t size );
+
+    size_t fBlockSize;
+    QVector< char * > fBlocks;
+    char * fCurr{ nullptr };
+    char * fEnd{ nullptr };
+    qint64 fBytesReserved{ 0 };
+    qint64 fBytesUsed{ 0 };
+    qint64 fBytesReleased{ 0 };
+    QHash< size_t, void * > fFreeLists; // by size, linked through their first word
+};
+
+#endif
@@ -0,0 +1,23 @@
+
+#ifndef EVICTABLEMODEL_H
+#define EVICTABLEMODEL_H
+
+#include <QModelIndex>
+
+// A model that can give fetched rows back. Evicted rows are removed with the
+// usual signals and come back through canFetchMore/fetchMore like rows never
+// fetched, so a view only notices them missing while they are out of sight.
+class EvictableModel
+{
+public:
+    virtual ~EvictableModel() {}
+
+    virtual qint64 residentBytes() const = 0; // what eviction can bring down
+    virtual int evictRows( const QModelIndex & parent, int keepRows ) = 0; // the shown children of parent from keepRows on, returns how many went
+
+    // What the model keeps per top level row outside keepFirst to keepLast and can
+    // compute again when asked, the rows themselves stay. Returns how many rows it released.
+    virtual int releaseRowData( int keepFirst, int keepLast ) { Q_UNUSED( keepFirst ); Q_UNUSED( keepLast ); return 0; }
+};
+
+#endif
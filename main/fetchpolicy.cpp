@@ -0,0 +1,87 @@
+
+#include "fetchpolicy.h"
+
+#include <cmath>
+
+namespace
+{
+    // fetches closer together than this are one burst, and keep growing
+    const qint64 kBurstWindowMS = 250;
+}
+
+FetchPolicy::FetchPolicy()
+{
+}
+
+void FetchPolicy::setFixedBatchSize( int size )
+{
+    fFixedBatchSize = qMax( 0, size );
+}
+
+void FetchPolicy::setViewportHeight( int pixels, int rowHeight )
+{
+    if ( rowHeight <= 0 )
+        return;
+    fViewportRows = qMax( 1, ( pixels + rowHeight - 1 ) / rowHeight );
+}
+
+void FetchPolicy::setTimeBudget( int msecs )
+{
+    fTimeBudgetMS = qMax( 1, msecs );
+}
+
+void FetchPolicy::setGrowthFactor( double factor )
+{
+    fGrowthFactor = qMax( 1.0, factor );
+}
+
+void FetchPolicy::setMaximumBatchSize( int size )
+{
+    fMaximumBatchSize = qMax( 1, size );
+}
+
+int FetchPolicy::batchSize( quintptr key, int remainder )
+{
+    if ( remainder <= 0 )
+        return 0;
+
+    if ( fFixedBatchSize > 0 )
+        return qMin( fFixedBatchSize, remainder );
+
+    bool inBurst = fLastFetch.isValid() && ( fLastFetch.elapsed() < kBurstWindowMS ) && ( key == fLastKey );
+    if ( inBurst )
+        fCurrentBatchSize = static_cast< int >( std::ceil( fCurrentBatchSize * fGrowthFactor ) );
+    else
+        fCurrentBatchSize = fViewportRows;
+    fCurrentBatchSize = qBound( 1, fCurrentBatchSize, fMaximumBatchSize );
+
+    if ( fNSecsPerRow > 0.0 )
+    {
+        auto budgetRows = static_cast< int >( qMin( ( fTimeBudgetMS * 1000000.0 ) / fNSecsPerRow, double( fMaximumBatchSize ) ) );
+        fCurrentBatchSize = qBound( 1, budgetRows, fCurrentBatchSize );
+    }
+
+    fLastKey = key;
+    fLastFetch.start();
+    return qMin( fCurrentBatchSize, remainder );
+}
+
+void FetchPolicy::batchFetched( int rows, qint64 nsecs )
+{
+    if ( rows <= 0 )
+        return;
+
+    auto perRow = double( nsecs ) / rows;
+    if ( fNSecsPerRow <= 0.0 )
+        fNSecsPerRow = perRow;
+    else
+        fNSecsPerRow = ( 0.75 * fNSecsPerRow ) + ( 0.25 * perRow );
+}
+
+void FetchPolicy::reset()
+{
+    fCurrentBatchSize = 0;
+    fNSecsPerRow = 0.0;
+    fLastKey = 0;
+    fLastFetch.invalidate();
+}
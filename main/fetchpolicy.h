@@ -0,0 +1,47 @@
+
+#ifndef FETCHPOLICY_H
+#define FETCHPOLICY_H
+
+#include <QElapsedTimer>
+#include <QtGlobal>
+
+// Sizes fetchMore batches: the first fetch fills the viewport, repeated fetches on
+// the same parent grow geometrically, capped by the measured insert cost per row.
+class FetchPolicy
+{
+public:
+    FetchPolicy();
+
+    void setFixedBatchSize( int size ); // 0 returns to adaptive sizing
+    int fixedBatchSize() const { return fFixedBatchSize; }
+
+    void setViewportHeight( int pixels, int rowHeight );
+    int viewportRows() const { return fViewportRows; }
+
+    void setTimeBudget( int msecs );
+    int timeBudget() const { return fTimeBudgetMS; }
+
+    void setGrowthFactor( double factor );
+    double growthFactor() const { return fGrowthFactor; }
+
+    void setMaximumBatchSize( int size );
+    int maximumBatchSize() const { return fMaximumBatchSize; }
+
+    int batchSize( quintptr key, int remainder );
+    void batchFetched( int rows, qint64 nsecs );
+
+    void reset();
+private:
+    int fFixedBatchSize{ 0 };
+    int fViewportRows{ 32 };
+    int fTimeBudgetMS{ 16 };
+    double fGrowthFactor{ 2.0 };
+    int fMaximumBatchSize{ 10000 };
+
+    int fCurrentBatchSize{ 0 };
+    double fNSecsPerRow{ 0.0 };
+    quintptr fLastKey{ 0 };
+    QElapsedTimer fLastFetch;
+};
+
+#endif
@@ -0,0 +1,276 @@
+
+#include "filelistfiltermodel.h"
+#include "filelistmodel.h"
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <numeric>
+
+FileListFilterModel::FileListFilterModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+    fCollator.setNumericMode(true);
+    fCollator.setCaseSensitivity(Qt::CaseInsensitive);
+}
+
+void FileListFilterModel::setSourceModel(FileListModel *model)
+{
+    if (fSource)
+        disconnect(fSource, nullptr, this, nullptr);
+
+    fSource = model;
+    if (fSource) {
+        connect(fSource, &FileListModel::modelReset, this, &FileListFilterModel::rebuild);
+        connect(fSource, &FileListModel::entriesAppended, this, &FileListFilterModel::appendEntries);
+        connect(fSource, &FileListModel::entriesRemoved, this, &FileListFilterModel::removeEntries);
+        connect(fSource, &FileListModel::metadataChanged, this, &FileListFilterModel::updateMetadata);
+        connect(fSource, &FileListModel::directoryLoaded, this, [this]() {
+            if (fDeferred)
+                rebuild();
+        });
+    }
+    rebuild();
+}
+
+void FileListFilterModel::setFilterText(const QString &text)
+{
+    if (text == fFilterText)
+        return;
+
+    fFilterText = text;
+    rebuild();
+}
+
+void FileListFilterModel::sort(int column, Qt::SortOrder order)
+{
+    fSortColumn = column;
+    fSortOrder = order;
+    rebuild();
+}
+
+int FileListFilterModel::mapToSource(int row) const
+{
+    if (row < 0 || row >= fShown)
+        return -1;
+    if (row >= fGapStart)
+        row += fGapSize;
+    return fEntries[row];
+}
+
+bool FileListFilterModel::accepts(const QString &name) const
+{
+    return fFilterText.isEmpty() || name.contains(fFilterText, Qt::CaseInsensitive);
+}
+
+// Sorting needs the whole listing, while the source is still enumerating a
+// sorted model stays empty and is rebuilt once from directoryLoaded.
+void FileListFilterModel::rebuild()
+{
+    beginResetModel();
+    fEntries.clear();
+    fKeys.clear();
+    fRowOfEntryDirty = true;
+    fShown = 0;
+    fDeferred = false;
+    fFetchPolicy.reset();
+
+    if (fSource) {
+        if (isSorted() && fSource->isEnumerating()) {
+            fDeferred = true;
+        } else {
+            auto &&entries = fSource->entries();
+            for (int ii = 0; ii < entries.count(); ++ii) {
+                if (accepts(entries[ii]))
+                    fEntries << ii;
+            }
+            if (isSorted())
+                sortEntries();
+        }
+    }
+    endResetModel();
+}
+
+void FileListFilterModel::sortEntries()
+{
+    auto &&entries = fSource->entries();
+    std::vector<QCollatorSortKey> keys;
+    keys.reserve(fEntries.count());
+    for (auto &&entry : fEntries)
+        keys.push_back(fCollator.sortKey(entries[entry]));
+
+    std::vector<int> order(fEntries.count());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int lhs, int rhs) {
+        auto cmp = keys[lhs].compare(keys[rhs]);
+        return (fSortOrder == Qt::AscendingOrder) ? (cmp < 0) : (cmp > 0);
+    });
+
+    QVector<int> sorted;
+    sorted.reserve(fEntries.count());
+    for (auto &&ii : order) {
+        sorted << fEntries[ii];
+        fKeys.push_back(keys[ii]);
+    }
+    fEntries = sorted;
+}
+
+// Unsorted matches are appended like the source's chunks, sorted ones are
+// placed by binary search and signalled only when they land in the shown rows.
+void FileListFilterModel::appendEntries(int first, int last)
+{
+    if (fDeferred)
+        return;
+    if (isSorted() && fSource->isEnumerating()) {
+        rebuild();
+        return;
+    }
+
+    auto &&entries = fSource->entries();
+    fRowOfEntryDirty = true;
+    for (int entry = first; entry <= last; ++entry) {
+        if (!accepts(entries[entry]))
+            continue;
+
+        if (!isSorted()) {
+            fEntries << entry;
+            continue;
+        }
+
+        auto key = fCollator.sortKey(entries[entry]);
+        auto pos = std::upper_bound(fKeys.begin(), fKeys.end(), key, [this](const QCollatorSortKey &lhs, const QCollatorSortKey &rhs) {
+            auto cmp = lhs.compare(rhs);
+            return (fSortOrder == Qt::AscendingOrder) ? (cmp < 0) : (cmp > 0);
+        });
+        int row = pos - fKeys.begin();
+        if (row < fShown) {
+            beginInsertRows(QModelIndex(), row, row);
+            fEntries.insert(row, entry);
+            fKeys.insert(pos, key);
+            ++fShown;
+            endInsertRows();
+        } else {
+            fEntries.insert(row, entry);
+            fKeys.insert(pos, key);
+        }
+    }
+
+    if (fShown < fFetchPolicy.viewportRows())
+        fetchMore(QModelIndex());
+}
+
+// Like the source, one beginRemoveRows per run of adjacent shown rows and one
+// compacting pass behind them. The entries are renumbered first, the source has
+// already dropped the removed ones, so rows not yet passed read the right text.
+void FileListFilterModel::removeEntries(const QVector<int> &removed)
+{
+    if (fDeferred)
+        return;
+
+    fRowOfEntryDirty = true;
+    for (auto &&entry : fEntries) {
+        auto pos = std::lower_bound(removed.begin(), removed.end(), entry);
+        entry = (pos != removed.end() && *pos == entry) ? -1 : entry - int(pos - removed.begin());
+    }
+
+    int kept = 0;
+    int next = 0;
+    auto keepUntil = [&](int end) {
+        for (; next < end; ++next, ++kept) {
+            if (fEntries[next] < 0)
+                break;
+            if (kept != next) {
+                fEntries[kept] = fEntries[next];
+                if (isSorted())
+                    fKeys[kept] = std::move(fKeys[next]);
+            }
+        }
+        fGapStart = kept;
+    };
+
+    while (next < fEntries.count()) {
+        keepUntil(fEntries.count());
+        if (next == fEntries.count())
+            break;
+
+        // the run starts at row kept now, the rows before it are compacted
+        int last = next;
+        while (last + 1 < fEntries.count() && fEntries[last + 1] < 0)
+            ++last;
+        int shownRemoved = qBound(0, fShown - kept, last - next + 1);
+        if (shownRemoved)
+            beginRemoveRows(QModelIndex(), kept, kept + shownRemoved - 1);
+        next = last + 1;
+        fGapSize = next - kept;
+        fShown -= shownRemoved;
+        if (shownRemoved)
+            endRemoveRows();
+    }
+    fEntries.resize(kept);
+    if (isSorted())
+        fKeys.erase(fKeys.begin() + kept, fKeys.end());
+    fGapStart = 0;
+    fGapSize = 0;
+}
+
+void FileListFilterModel::updateMetadata(int first, int last)
+{
+    if (fRowOfEntryDirty) {
+        fRowOfEntry.fill(-1, fSource->entries().count());
+        for (int row = 0; row < fEntries.count(); ++row)
+            fRowOfEntry[fEntries[row]] = row;
+        fRowOfEntryDirty = false;
+    }
+
+    for (int entry = first; entry <= last && entry < fRowOfEntry.count(); ++entry) {
+        auto row = fRowOfEntry[entry];
+        if (row >= 0 && row < fShown)
+            emit dataChanged(index(row), index(row), { FileListModel::SizeRole, FileListModel::ModifiedRole, FileListModel::OwnerRole, FileListModel::TypeRole });
+    }
+}
+
+int FileListFilterModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : fShown;
+}
+
+QVariant FileListFilterModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= fShown)
+        return QVariant();
+
+    auto row = index.row();
+    if (row >= fGapStart)
+        row += fGapSize;
+    return fSource->entryData(fEntries[row], role);
+}
+
+QHash<int, QByteArray> FileListFilterModel::roleNames() const
+{
+    return fSource ? fSource->roleNames() : QAbstractListModel::roleNames();
+}
+
+bool FileListFilterModel::canFetchMore(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return false;
+    return fShown < fEntries.count();
+}
+
+void FileListFilterModel::fetchMore(const QModelIndex &parent)
+{
+    if (parent.isValid())
+        return;
+
+    int remainder = fEntries.count() - fShown;
+    int itemsToFetch = fFetchPolicy.batchSize(0, remainder);
+    if (itemsToFetch <= 0)
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+    beginInsertRows(QModelIndex(), fShown, fShown + itemsToFetch - 1);
+    fShown += itemsToFetch;
+    endInsertRows();
+    fFetchPolicy.batchFetched(itemsToFetch, timer.nsecsElapsed());
+}
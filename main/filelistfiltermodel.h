@@ -0,0 +1,70 @@
+
+#ifndef FILELISTFILTERMODEL_H
+#define FILELISTFILTERMODEL_H
+
+#include <QAbstractListModel>
+#include <QCollator>
+#include <QVector>
+
+#include <vector>
+
+#include "fetchpolicy.h"
+
+class FileListModel;
+
+// Filters and sorts the whole listing of a FileListModel, including entries it
+// has not fetched, and shows the result in fetchMore batches of its own.
+// Sort keys are computed once per entry. A sorted listing appears when the
+// enumeration finishes, later additions are inserted in place.
+class FileListFilterModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    FileListFilterModel(QObject *parent = nullptr);
+
+    void setSourceModel(FileListModel *model);
+    FileListModel *sourceModel() const { return fSource; }
+
+    void setFilterText(const QString &text); // case insensitive, empty keeps every entry
+    QString filterText() const { return fFilterText; }
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override; // column -1 keeps listing order
+
+    int mapToSource(int row) const; // the entry number in the source's listing
+    FetchPolicy &fetchPolicy() { return fFetchPolicy; }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+protected:
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+private:
+    bool accepts(const QString &name) const;
+    bool isSorted() const { return fSortColumn >= 0; }
+    void rebuild();
+    void sortEntries();
+    void appendEntries(int first, int last);
+    void removeEntries(const QVector<int> &removed);
+    void updateMetadata(int first, int last);
+
+    FileListModel *fSource{ nullptr };
+    QString fFilterText;
+    int fSortColumn{ -1 };
+    Qt::SortOrder fSortOrder{ Qt::AscendingOrder };
+    QCollator fCollator;
+
+    QVector<int> fEntries; // the source entry of each row
+    int fGapStart{ 0 }; // while removeEntries signals, rows from here on are stored fGapSize further along
+    int fGapSize{ 0 };
+    std::vector<QCollatorSortKey> fKeys; // parallel to fEntries while sorted
+    QVector<int> fRowOfEntry; // rebuilt on demand, -1 for filtered out entries
+    bool fRowOfEntryDirty{ true };
+    int fShown{ 0 };
+    bool fDeferred{ false }; // sorted and waiting for the enumeration to finish
+    FetchPolicy fFetchPolicy;
+};
+
+#endif // FILELISTFILTERMODEL_H
@@ -53,50 +53,145 @@
 #include <QGuiApplication>
 #include <QDir>
 #include <QPalette>
+#include <QElapsedTimer>
+#include <QDirIterator>
+#include <QtConcurrent>
+#include <QFileInfo>
+#include <QTimer>
+#include <QFileSystemWatcher>
+#include <QSet>
+
+#include <algorithm>
+
+namespace
+{
+    // entries are handed from the enumeration worker to the model in chunks
+    const int kChunkSize = 512;
+    const qint64 kChunkIntervalMS = 50;
+
+    const int kDefaultCacheEntries = 1000000;
+
+    // rows stat'ed per worker round trip, and so per dataChanged
+    const int kStatBatchSize = 256;
+
+    // metadata is allocated and released a page at a time
+    const int kMetadataPageSize = 1024;
+}
 
 FileListModel::FileListModel(QObject *parent)
-    : QAbstractListModel(parent), fileCount(0)
-{}
+    : QAbstractListModel(parent), fileCount(0),
+    fListingCache(kDefaultCacheEntries)
+{
+    fDebounceTimer = new QTimer(this);
+    fDebounceTimer->setSingleShot(true);
+    fDebounceTimer->setInterval(0);
+    connect(fDebounceTimer, &QTimer::timeout, this, &FileListModel::applyDirPath);
+
+    // every change notification of one event loop pass is handled by one rescan
+    fRescanTimer = new QTimer(this);
+    fRescanTimer->setSingleShot(true);
+    fRescanTimer->setInterval(0);
+    connect(fRescanTimer, &QTimer::timeout, this, &FileListModel::rescan);
+
+    fStatTimer = new QTimer(this);
+    fStatTimer->setSingleShot(true);
+    fStatTimer->setInterval(0);
+    connect(fStatTimer, &QTimer::timeout, this, &FileListModel::statNextBatch);
+}
+
+FileListModel::~FileListModel()
+{
+    cancelEnumeration();
+    for (auto &&worker : fWorkers)
+        worker.waitForFinished();
+}
 
 //![4]
 int FileListModel::rowCount(const QModelIndex &parent) const
 {
+    fStats.count(ModelStats::eRowCount);
     return parent.isValid() ? 0 : fileCount;
 }
 
 QVariant FileListModel::data(const QModelIndex &index, int role) const
 {
+    fStats.count(ModelStats::eData);
     if (!index.isValid())
         return QVariant();
 
-    if (index.row() >= fileList.size() || index.row() < 0)
+    return entryData(index.row(), role);
+}
+
+// Works for every entry of the listing, whether or not it has been fetched
+QVariant FileListModel::entryData(int entry, int role) const
+{
+    if (entry >= fileList.size() - fGapSize || entry < 0)
         return QVariant();
+    if (entry >= fGapStart)
+        entry += fGapSize;
 
     if (role == Qt::DisplayRole) {
-        return fileList.at(index.row());
+        return fileList.at(entry);
     } else if (role == Qt::BackgroundRole) {
-        int batch = (index.row() / 100) % 2;
+        int batch = (entry / 100) % 2;
         if (batch == 0)
             return qApp->palette().base();
         else
             return qApp->palette().alternateBase();
+    } else if (role >= SizeRole && role <= TypeRole) {
+        auto metadata = metadataAt(entry);
+        if (metadata.state != FileMetadata::eKnown) {
+            requestMetadata(entry, entry);
+            return QVariant();
+        }
+        switch (role) {
+        case SizeRole:
+            return metadata.size;
+        case ModifiedRole:
+            return QDateTime::fromSecsSinceEpoch(metadata.modified);
+        case OwnerRole:
+            return fOwnerNames.value(metadata.ownerId);
+        case TypeRole:
+            switch (metadata.type) {
+            case FileMetadata::eFile:
+                return tr("File");
+            case FileMetadata::eDirectory:
+                return tr("Directory");
+            case FileMetadata::eLink:
+                return tr("Link");
+            default:
+                return tr("Other");
+            }
+        }
     }
     return QVariant();
 }
+
+QHash<int, QByteArray> FileListModel::roleNames() const
+{
+    auto names = QAbstractListModel::roleNames();
+    names[SizeRole] = "size";
+    names[ModifiedRole] = "modified";
+    names[OwnerRole] = "owner";
+    names[TypeRole] = "type";
+    return names;
+}
 //![4]
 
 //![1]
 bool FileListModel::canFetchMore(const QModelIndex &parent) const
 {
+    fStats.count(ModelStats::eCanFetchMore);
     if (parent.isValid())
         return false;
-    return (fileCount < fileList.size());
+    return (fileCount < fileList.size()) || fEnumerating;
 }
 //![1]
 
 //![2]
 void FileListModel::fetchMore(const QModelIndex &parent)
 {
+    fStats.count(ModelStats::eFetchMore);
     if (parent.isValid())
         return;
     if ( fetchingMore )
@@ -104,20 +199,28 @@ void FileListModel::fetchMore(const QModelIndex &parent)
 
     fetchingMore = true;
     int remainder = fileList.size() - fileCount;
-    int itemsToFetch = qMin( qMin(100, remainder), 1 );
+    int itemsToFetch = fFetchPolicy.batchSize( 0, remainder );
 
     if (itemsToFetch <= 0)
     {
+        fFetchPending = fEnumerating;
         fetchingMore = false;
         return;
     }
 
     auto r1 = rowCount( parent );
+    auto firstNew = fileCount;
+    QElapsedTimer timer;
+    timer.start();
     beginInsertRows(QModelIndex(), fileCount, fileCount + itemsToFetch - 1);
 
     fileCount += itemsToFetch;
 
     endInsertRows();
+    auto nsecs = timer.nsecsElapsed();
+    fFetchPolicy.batchFetched( itemsToFetch, nsecs );
+    fStats.rowsInserted(itemsToFetch, nsecs);
+    requestMetadata( firstNew, fileCount - 1 );
     auto r2 = rowCount( parent );
 
     if ( r1 != r2 )
@@ -128,16 +231,485 @@ void FileListModel::fetchMore(const QModelIndex &parent)
 }
 //![2]
 
+qint64 FileListModel::residentBytes() const
+{
+    return qint64(fMetadataPages) * kMetadataPageSize * sizeof(FileMetadata);
+}
+
+// hiding rows would free nothing, the listing is held whole in fileList
+int FileListModel::evictRows(const QModelIndex &parent, int keepRows)
+{
+    Q_UNUSED(parent);
+    Q_UNUSED(keepRows);
+    return 0;
+}
+
+// Only pages wholly outside the kept rows go, a stat still out for one of their
+// rows allocates the page again when it lands.
+int FileListModel::releaseRowData(int keepFirst, int keepLast)
+{
+    int released = 0;
+    for (int page = 0; page < int(fMetadata.size()); ++page) {
+        auto first = page * kMetadataPageSize;
+        auto last = first + kMetadataPageSize - 1;
+        if (!fMetadata[page] || (last >= keepFirst && first <= keepLast))
+            continue;
+        fMetadata[page].reset();
+        --fMetadataPages;
+        released += qMin(last, fileList.count() - 1) - first + 1;
+    }
+    return released;
+}
+
+int FileListModel::debounceInterval() const
+{
+    return fDebounceTimer->interval();
+}
+
+void FileListModel::setDebounceInterval(int msecs)
+{
+    fDebounceTimer->setInterval(qMax(0, msecs));
+}
+
+void FileListModel::setListingCacheSize(int maxEntries)
+{
+    fListingCache.setMaxCost(maxEntries);
+}
+
 //![0]
+// Calls within the debounce interval of each other collapse into the last one.
 void FileListModel::setDirPath(const QString &path)
 {
-    QDir dir(path);
+    fPendingPath = path;
+    if (fDebounceTimer->interval() == 0) {
+        fDebounceTimer->stop();
+        applyDirPath();
+    } else {
+        fDebounceTimer->start();
+    }
+}
+
+// The directory is streamed by a worker, entries arrive in chunks and are
+// revealed through fetchMore. A newer path cancels the running enumeration
+// without waiting for it, its chunks are dropped by the generation check.
+// Complete listings are cached and reused while the directory's mtime is unchanged.
+void FileListModel::applyDirPath()
+{
+    auto path = fPendingPath;
+    fLoadTimer.start();
+    cancelEnumeration();
+    auto generation = ++fGeneration; // before the cache check, queued chunks must not land in a cached listing
+    fCurrentPath = QDir::cleanPath(QDir(path).absolutePath());
+    fRescanPending = false;
+    watchCurrentPath();
+    if (useCachedListing(path))
+        return;
 
     beginResetModel();
-    fileList = dir.entryList();
+    fileList.clear();
+    resizeMetadata(0);
+    fStatQueue.clear();
     fileCount = 0;
+    fFetchPending = false;
+    fFetchPolicy.reset();
     endResetModel();
+
+    auto cancel = std::make_shared< std::atomic< bool > >(false);
+    fCancelEnumeration = cancel;
+    fEnumerating = true;
+    addWorker(QtConcurrent::run([this, path, generation, cancel]() {
+        auto modified = QFileInfo(path).lastModified();
+        QDirIterator it(path, QDir::AllEntries);
+        QStringList chunk;
+        QElapsedTimer sinceChunk;
+        sinceChunk.start();
+        while (!*cancel && it.hasNext()) {
+            it.next();
+            chunk << it.fileName();
+            if (chunk.count() >= kChunkSize || sinceChunk.elapsed() >= kChunkIntervalMS) {
+                QMetaObject::invokeMethod(this, [this, generation, chunk]() {
+                    appendEntries(generation, chunk);
+                }, Qt::QueuedConnection);
+                chunk.clear();
+                sinceChunk.restart();
+            }
+        }
+        if (*cancel)
+            return;
+        QMetaObject::invokeMethod(this, [this, generation, chunk, path, modified]() {
+            appendEntries(generation, chunk);
+            finishEnumeration(generation, path, modified);
+        }, Qt::QueuedConnection);
+    }));
 }
 //![0]
 
+bool FileListModel::useCachedListing(const QString &path)
+{
+    auto key = fCurrentPath;
+    auto listing = fListingCache.object(key);
+    if (listing && listing->modified.isValid() && listing->modified == QFileInfo(key).lastModified()) {
+        beginResetModel();
+        fileList = listing->entries;
+        resizeMetadata(0);
+        resizeMetadata(fileList.count());
+        fStatQueue.clear();
+        fileCount = 0;
+        fFetchPending = false;
+        fFetchPolicy.reset();
+        endResetModel();
+
+        fCacheHits++;
+        fStats.loaded(fLoadTimer.nsecsElapsed());
+        emit cacheStatsChanged();
+        emit directoryLoaded(path);
+        return true;
+    }
+
+    if (listing)
+        fListingCache.remove(key);
+    fCacheMisses++;
+    emit cacheStatsChanged();
+    return false;
+}
+
+// finished workers are dropped here, so the list only holds the few still running
+void FileListModel::addWorker(const QFuture<void> &worker)
+{
+    for (int ii = fWorkers.count() - 1; ii >= 0; --ii) {
+        if (fWorkers[ii].isFinished())
+            fWorkers.removeAt(ii);
+    }
+    fWorkers << worker;
+}
+
+void FileListModel::cancelEnumeration()
+{
+    if (fCancelEnumeration)
+        *fCancelEnumeration = true;
+    fCancelEnumeration.reset();
+    fEnumerating = false;
+}
+
+void FileListModel::appendEntries(int generation, const QStringList &entries)
+{
+    if (generation != fGeneration || entries.isEmpty())
+        return;
+
+    // new entries stay hidden until fetched, only top up an unfilled viewport
+    fileList += entries;
+    resizeMetadata(fileList.count());
+    emit entriesAppended(fileList.count() - entries.count(), fileList.count() - 1);
+    if (fFetchPending || fileCount < fFetchPolicy.viewportRows()) {
+        fFetchPending = false;
+        fetchMore(QModelIndex());
+    }
+}
+
+void FileListModel::finishEnumeration(int generation, const QString &path, const QDateTime &modified)
+{
+    if (generation != fGeneration)
+        return;
+
+    fEnumerating = false;
+    fCancelEnumeration.reset();
+    fStats.loaded(fLoadTimer.nsecsElapsed());
+    if (modified.isValid())
+        fListingCache.insert(fCurrentPath, new Listing{ fileList, modified }, qMax(1, fileList.count()));
+    emit directoryLoaded(path);
+
+    if (fRescanPending)
+        fRescanTimer->start();
+}
 
+void FileListModel::setWatchEnabled(bool watch)
+{
+    if (watch == isWatching())
+        return;
+
+    if (watch) {
+        fWatcher = new QFileSystemWatcher(this);
+        connect(fWatcher, &QFileSystemWatcher::directoryChanged, this, &FileListModel::scheduleRescan);
+        watchCurrentPath();
+    } else {
+        delete fWatcher;
+        fWatcher = nullptr;
+        fRescanTimer->stop();
+        fRescanPending = false;
+    }
+}
+
+void FileListModel::watchCurrentPath()
+{
+    if (!fWatcher)
+        return;
+
+    auto watched = fWatcher->directories();
+    if (!watched.isEmpty())
+        fWatcher->removePaths(watched);
+    if (QFileInfo(fCurrentPath).isDir())
+        fWatcher->addPath(fCurrentPath);
+}
+
+void FileListModel::scheduleRescan()
+{
+    fRescanPending = true;
+    if (!fEnumerating && !fRescanning)
+        fRescanTimer->start();
+}
+
+// The directory is listed again on a worker and compared with fileList there,
+// the GUI thread only applies the resulting removals and additions.
+void FileListModel::rescan()
+{
+    if (!fRescanPending || fEnumerating || fRescanning)
+        return;
+
+    fRescanPending = false;
+    fRescanning = true;
+    auto generation = fGeneration;
+    auto path = fCurrentPath;
+    auto snapshot = fileList;
+    addWorker(QtConcurrent::run([this, generation, path, snapshot]() {
+        DirectoryDiff diff;
+        diff.modified = QFileInfo(path).lastModified();
+        QStringList current;
+        QDirIterator it(path, QDir::AllEntries);
+        while (it.hasNext()) {
+            it.next();
+            current << it.fileName();
+        }
+
+        auto currentSet = QSet< QString >(current.begin(), current.end());
+        for (int ii = 0; ii < snapshot.count(); ++ii) {
+            if (!currentSet.contains(snapshot[ii]))
+                diff.removedRows << ii;
+        }
+        auto previousSet = QSet< QString >(snapshot.begin(), snapshot.end());
+        for (auto &&name : current) {
+            if (!previousSet.contains(name))
+                diff.added << name;
+        }
+
+        QMetaObject::invokeMethod(this, [this, generation, diff]() {
+            applyDiff(generation, diff);
+        }, Qt::QueuedConnection);
+    }));
+}
+
+// A burst of changes is one model transaction for the removals and one append.
+// Rows that were never fetched change silently, the view does not know them yet.
+void FileListModel::applyDiff(int generation, const DirectoryDiff &diff)
+{
+    fRescanning = false;
+    if (generation != fGeneration)
+        return;
+
+    auto &&removed = diff.removedRows;
+    if (!removed.isEmpty())
+        removeEntries(removed);
+
+    // queued rows shifted, they are asked for again the next time they are shown
+    if (!removed.isEmpty()) {
+        for (auto &&page : fMetadata) {
+            for (int ii = 0; page && ii < kMetadataPageSize; ++ii) {
+                if (page[ii].state == FileMetadata::eRequested)
+                    page[ii].state = FileMetadata::eUnknown;
+            }
+        }
+        fStatQueue.clear();
+    }
+
+    if (!diff.added.isEmpty()) {
+        bool allShown = (fileCount == fileList.count());
+        int firstNew = fileCount;
+        fileList += diff.added;
+        resizeMetadata(fileList.count());
+        emit entriesAppended(firstNew, fileList.count() - 1);
+        if (allShown) {
+            QElapsedTimer timer;
+            timer.start();
+            beginInsertRows(QModelIndex(), fileCount, fileList.count() - 1);
+            fileCount = fileList.count();
+            endInsertRows();
+            fStats.rowsInserted(fileCount - firstNew, timer.nsecsElapsed());
+            requestMetadata(firstNew, fileCount - 1);
+        }
+    }
+
+    if (diff.modified.isValid())
+        fListingCache.insert(fCurrentPath, new Listing{ fileList, diff.modified }, qMax(1, fileList.count()));
+
+    if (fRescanPending)
+        fRescanTimer->start();
+}
+
+// Each run of adjacent shown rows is its own beginRemoveRows, front to back, so
+// proxies see every row go. Both vectors are still compacted in a single pass:
+// the kept entries move down as the runs are passed, and until the pass ends
+// the entries from fGapStart on are read fGapSize further along.
+void FileListModel::removeEntries(const QVector<int> &removed)
+{
+    int kept = 0;
+    int next = 0;
+    auto keepUntil = [&](int end) {
+        for (; next < end; ++next, ++kept) {
+            if (kept != next) {
+                fileList[kept] = std::move(fileList[next]);
+                setMetadata(kept, metadataAt(next));
+            }
+        }
+        fGapStart = kept;
+    };
+
+    for (int ii = 0; ii < removed.count();) {
+        int first = removed[ii];
+        int last = first;
+        for (++ii; ii < removed.count() && removed[ii] == last + 1; ++ii)
+            ++last;
+
+        // the run starts at row kept now, the rows before it are compacted
+        keepUntil(first);
+        int shownRemoved = qBound(0, fileCount - kept, last - first + 1);
+        if (shownRemoved)
+            beginRemoveRows(QModelIndex(), kept, kept + shownRemoved - 1);
+        next = last + 1;
+        fGapSize = next - kept;
+        fileCount -= shownRemoved;
+        if (shownRemoved)
+            endRemoveRows();
+    }
+    keepUntil(fileList.count());
+    fileList.erase(fileList.begin() + kept, fileList.end());
+    resizeMetadata(kept);
+    fGapStart = 0;
+    fGapSize = 0;
+    emit entriesRemoved(removed);
+}
+
+FileListModel::FileMetadata FileListModel::metadataAt(int entry) const
+{
+    auto &&page = fMetadata[entry / kMetadataPageSize];
+    return page ? page[entry % kMetadataPageSize] : FileMetadata();
+}
+
+FileListModel::FileMetadata &FileListModel::metadataRef(int entry) const
+{
+    auto &&page = fMetadata[entry / kMetadataPageSize];
+    if (!page) {
+        page = std::make_unique<FileMetadata[]>(kMetadataPageSize);
+        ++fMetadataPages;
+    }
+    return page[entry % kMetadataPageSize];
+}
+
+// unknown metadata needs no page
+void FileListModel::setMetadata(int entry, const FileMetadata &metadata)
+{
+    if (metadata.state != FileMetadata::eUnknown || fMetadata[entry / kMetadataPageSize])
+        metadataRef(entry) = metadata;
+}
+
+// entries past count in the last page are reset, so they start unknown when it grows again
+void FileListModel::resizeMetadata(int count)
+{
+    int pages = (count + kMetadataPageSize - 1) / kMetadataPageSize;
+    for (int page = pages; page < int(fMetadata.size()); ++page) {
+        if (fMetadata[page])
+            --fMetadataPages;
+    }
+    fMetadata.resize(pages);
+    if (pages && fMetadata.back() && count % kMetadataPageSize)
+        std::fill(fMetadata.back().get() + count % kMetadataPageSize, fMetadata.back().get() + kMetadataPageSize, FileMetadata());
+}
+
+void FileListModel::requestMetadata(int first, int last) const
+{
+    for (int row = first; row <= last; ++row) {
+        if (metadataAt(row).state != FileMetadata::eUnknown)
+            continue;
+        metadataRef(row).state = FileMetadata::eRequested;
+        fStatQueue << row;
+    }
+    if (!fStatting && !fStatQueue.isEmpty())
+        fStatTimer->start();
+}
+
+// One worker round trip stats a batch of queued rows, the results are
+// published with a single dataChanged covering the batch.
+void FileListModel::statNextBatch()
+{
+    if (fStatting || fStatQueue.isEmpty())
+        return;
+
+    MetadataBatch batch;
+    int count = qMin(kStatBatchSize, fStatQueue.count());
+    for (int ii = 0; ii < count; ++ii) {
+        auto row = fStatQueue[ii];
+        if (row >= fileList.count())
+            continue;
+        batch.rows << row;
+        batch.names << fileList[row];
+    }
+    fStatQueue.remove(0, count);
+
+    fStatting = true;
+    auto generation = fGeneration;
+    auto dir = QDir(fCurrentPath);
+    addWorker(QtConcurrent::run([this, generation, dir, batch]() mutable {
+        batch.metadata.resize(batch.names.count());
+        for (int ii = 0; ii < batch.names.count(); ++ii) {
+            QFileInfo fi(dir.filePath(batch.names[ii]));
+            auto &&metadata = batch.metadata[ii];
+            metadata.size = fi.size();
+            metadata.modified = fi.lastModified().toSecsSinceEpoch();
+            metadata.ownerId = fi.ownerId();
+            if (fi.isSymLink())
+                metadata.type = FileMetadata::eLink;
+            else if (fi.isDir())
+                metadata.type = FileMetadata::eDirectory;
+            else if (fi.isFile())
+                metadata.type = FileMetadata::eFile;
+            else
+                metadata.type = FileMetadata::eOther;
+            metadata.state = FileMetadata::eKnown;
+            if (!batch.owners.contains(metadata.ownerId))
+                batch.owners[metadata.ownerId] = fi.owner();
+        }
+        QMetaObject::invokeMethod(this, [this, generation, batch]() {
+            applyMetadata(generation, batch);
+        }, Qt::QueuedConnection);
+    }));
+}
+
+void FileListModel::applyMetadata(int generation, const MetadataBatch &batch)
+{
+    fStatting = false;
+    if (generation == fGeneration) {
+        int first = -1;
+        int last = -1;
+        for (int ii = 0; ii < batch.rows.count(); ++ii) {
+            auto row = batch.rows[ii];
+            if (row >= fileList.count())
+                continue;
+            // the row moved under a rescan, let the next request pick it up again
+            if (fileList[row] != batch.names[ii]) {
+                setMetadata(row, FileMetadata());
+                continue;
+            }
+            setMetadata(row, batch.metadata[ii]);
+            first = (first < 0) ? row : qMin(first, row);
+            last = qMax(last, row);
+        }
+        for (auto it = batch.owners.constBegin(); it != batch.owners.constEnd(); ++it)
+            fOwnerNames.insert(it.key(), it.value());
+
+        if (first >= 0)
+            emit metadataChanged(first, last);
+        if (first >= 0 && first < fileCount)
+            emit dataChanged(index(first), index(qMin(last, fileCount - 1)), { SizeRole, ModifiedRole, OwnerRole, TypeRole });
+    }
+
+    if (!fStatQueue.isEmpty())
+        fStatTimer->start();
+}
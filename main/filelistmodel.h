@@ -53,20 +53,80 @@
 
 #include <QAbstractListModel>
 #include <QStringList>
+#include <QFuture>
+#include <QCache>
+#include <QDateTime>
+#include <QHash>
+#include <QElapsedTimer>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "fetchpolicy.h"
+#include "modelstats.h"
+#include "evictablemodel.h"
+
+class QTimer;
+class QFileSystemWatcher;
 
 //![0]
-class FileListModel : public QAbstractListModel
+class FileListModel : public QAbstractListModel, public EvictableModel
 {
     Q_OBJECT
+    Q_PROPERTY(int cacheHits READ cacheHits NOTIFY cacheStatsChanged)
+    Q_PROPERTY(int cacheMisses READ cacheMisses NOTIFY cacheStatsChanged)
+    Q_PROPERTY(int debounceInterval READ debounceInterval WRITE setDebounceInterval)
 
 public:
+    // metadata roles are filled in the background, they are invalid until a row has been stat'ed
+    enum Roles
+    {
+        SizeRole = Qt::UserRole + 1,
+        ModifiedRole,
+        OwnerRole,
+        TypeRole
+    };
+
     FileListModel(QObject *parent = nullptr);
+    ~FileListModel();
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    // the whole listing, including entries not fetched into the model yet,
+    // consistent again once entriesRemoved is emitted
+    const QStringList &entries() const { return fileList; }
+    QVariant entryData(int entry, int role = Qt::DisplayRole) const;
+
+    FetchPolicy & fetchPolicy() { return fFetchPolicy; }
+    ModelStats & stats() { return fStats; }
+    bool isEnumerating() const { return fEnumerating; }
+
+    // The whole listing stays in memory, so rows are never evicted. The metadata
+    // of rows far from the viewport is released and stat'ed again when shown.
+    qint64 residentBytes() const override;
+    int evictRows(const QModelIndex &parent, int keepRows) override;
+    int releaseRowData(int keepFirst, int keepLast) override;
+
+    int debounceInterval() const;
+    void setDebounceInterval(int msecs); // 0 applies every setDirPath immediately
+    void setListingCacheSize(int maxEntries);
+    void setWatchEnabled(bool watch); // follow changes to the directory with targeted row inserts and removes
+    bool isWatching() const { return fWatcher != nullptr; }
+
+    int cacheHits() const { return fCacheHits; }
+    int cacheMisses() const { return fCacheMisses; }
 
 signals:
     void numberPopulated(int number);
+    void directoryLoaded(const QString &path);
+    void cacheStatsChanged();
+    // listing changes in entry numbers, emitted for fetched and unfetched entries alike
+    void entriesAppended(int first, int last);
+    void entriesRemoved(const QVector<int> &entries); // ascending, numbered as before the removal
+    void metadataChanged(int first, int last);
 
 public slots:
     void setDirPath(const QString &path);
@@ -76,9 +136,94 @@ protected:
     void fetchMore(const QModelIndex &parent) override;
 
 private:
+    struct Listing
+    {
+        QStringList entries;
+        QDateTime modified; // of the directory when the enumeration started
+    };
+
+    struct FileMetadata
+    {
+        enum EState : quint8 { eUnknown, eRequested, eKnown };
+        enum EType : quint8 { eFile, eDirectory, eLink, eOther };
+
+        qint64 size{ -1 };
+        qint64 modified{ 0 }; // seconds since the epoch
+        uint ownerId{ 0 };
+        EType type{ eOther };
+        EState state{ eUnknown };
+    };
+
+    struct MetadataBatch
+    {
+        QVector< int > rows;
+        QStringList names; // to detect rows that moved while the batch was out
+        QVector< FileMetadata > metadata;
+        QHash< uint, QString > owners;
+    };
+
+    struct DirectoryDiff
+    {
+        QVector< int > removedRows; // ascending
+        QStringList added;
+        QDateTime modified;
+    };
+
+    void applyDirPath();
+    void watchCurrentPath();
+    void scheduleRescan();
+    void rescan();
+    void applyDiff(int generation, const DirectoryDiff &diff);
+    void removeEntries(const QVector<int> &removed);
+    FileMetadata metadataAt(int entry) const;
+    FileMetadata &metadataRef(int entry) const; // allocates its page
+    void setMetadata(int entry, const FileMetadata &metadata);
+    void resizeMetadata(int count);
+    void requestMetadata(int first, int last) const;
+    void statNextBatch();
+    void applyMetadata(int generation, const MetadataBatch &batch);
+    bool useCachedListing(const QString &path);
+    void addWorker(const QFuture<void> &worker);
+    void cancelEnumeration();
+    void appendEntries(int generation, const QStringList &entries);
+    void finishEnumeration(int generation, const QString &path, const QDateTime &modified);
+
     QStringList fileList;
     int fileCount;
+    int fGapStart{ 0 }; // while removeEntries signals, entries from here on are stored fGapSize further along
+    int fGapSize{ 0 };
     bool fetchingMore{ false };
+    FetchPolicy fFetchPolicy;
+    mutable ModelStats fStats;
+    QElapsedTimer fLoadTimer; // from applyDirPath to a complete listing
+
+    // directories are read on a worker, each setDirPath starts a new generation
+    std::shared_ptr< std::atomic< bool > > fCancelEnumeration;
+    QList< QFuture< void > > fWorkers; // enumerations, rescans and stat batches, waited for on destruction
+    int fGeneration{ 0 };
+    bool fEnumerating{ false };
+    bool fFetchPending{ false }; // the view asked for more before the next chunk arrived
+
+    QTimer *fDebounceTimer;
+    QString fPendingPath;
+    QString fCurrentPath;
+    QCache< QString, Listing > fListingCache; // LRU, the cost is the entry count
+    int fCacheHits{ 0 };
+    int fCacheMisses{ 0 };
+
+    QFileSystemWatcher *fWatcher{ nullptr };
+    QTimer *fRescanTimer;
+    bool fRescanning{ false };
+    bool fRescanPending{ false };
+
+    // one entry per fileList entry, requested from data() and fetchMore, filled by a worker;
+    // in pages of kMetadataPageSize entries, a missing page is all eUnknown
+    mutable std::vector< std::unique_ptr< FileMetadata[] > > fMetadata;
+    mutable int fMetadataPages{ 0 }; // allocated
+    mutable QVector< int > fStatQueue;
+    QTimer *fStatTimer;
+    bool fStatting{ false };
+    QHash< uint, QString > fOwnerNames;
 };
 //![0]
 
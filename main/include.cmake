@@ -1,19 +1,48 @@
 set(qtproject_SRCS
     main.cpp    
+    mainwindow.cpp
     treeitem.cpp
     treemodel.cpp
     filelistmodel.cpp
+    fetchpolicy.cpp
+    outlinescanner.cpp
+    outlineindex.cpp
+    outlinesnapshot.cpp
+    arena.cpp
+    stringtable.cpp
+    searchindex.cpp
+    treefiltermodel.cpp
+    filelistfiltermodel.cpp
+    scrollprefetcher.cpp
+    rowevictor.cpp
+    modelstats.cpp
+    modelchecker.cpp
     window.cpp
 )
 
 set(qtproject_H
+   mainwindow.h
    treemodel.h
    filelistmodel.h
+   treefiltermodel.h
+   filelistfiltermodel.h
+   scrollprefetcher.h
+   rowevictor.h
+   modelchecker.h
    window.h
 )
 
 set(project_H
     treeitem.h
+    fetchpolicy.h
+    outlinescanner.h
+    outlineindex.h
+    outlinesnapshot.h
+    arena.h
+    stringtable.h
+    searchindex.h
+    modelstats.h
+    evictablemodel.h
 )
 
 set(qtproject_UIS
@@ -1,42 +1,8 @@
-#include "treemodel.h"
+#include "mainwindow.h"
 #include "window.h"
-#include "SABUtils/AutoFetch.h"
 
-#include <QMainWindow>
 #include <QApplication>
-#include <QHeaderView>
-#include <QFile>
-#include <QAbstractItemModelTester>
 #include <QLoggingCategory>
-#include <QTreeView>
-#include <QScrollBar>
-
-#include <cstdint>
-#include <iostream>
-
-MainWindow::MainWindow( QWidget * parent )
-    : QMainWindow( parent )
-{
-    QFile file( ":/default.txt" );
-    file.open( QIODevice::ReadOnly );
-    TreeModel * model = new TreeModel( this );
-    //new QAbstractItemModelTester( model, QAbstractItemModelTester::FailureReportingMode::Fatal, this );
-    model->load( file.readAll() );
-
-    file.close();
-
-    fView = new QTreeView( this );
-    new NQtUtils::CAutoFetchMore( fView );
-    fView->setModel( model );
-    setCentralWidget( fView );
-    fView->show();
-
-    fView->installEventFilter( this );
-}
-
-MainWindow::~MainWindow()
-{
-}
 
 int main( int argc, char * argv[] )
 {
@@ -0,0 +1,202 @@
+
+#include "mainwindow.h"
+#include "treemodel.h"
+#include "treefiltermodel.h"
+#include "scrollprefetcher.h"
+#include "modelchecker.h"
+#include "rowevictor.h"
+#include "SABUtils/AutoFetch.h"
+
+#include <QTreeView>
+#include <QHeaderView>
+#include <QLineEdit>
+#include <QVBoxLayout>
+#include <QAbstractItemModelTester>
+#include <QScrollBar>
+#include <QAction>
+#include <QSignalBlocker>
+#include <QDebug>
+#include <QStandardPaths>
+
+MainWindow::MainWindow( QWidget * parent )
+    : QMainWindow( parent )
+{
+    fModel = new TreeModel( this );
+    // FETCHMORE_STATS collects from the first load on, the context menu toggles it later
+    fModel->stats().setEnabled( qEnvironmentVariableIsSet( "FETCHMORE_STATS" ) );
+    // reopening an unchanged outline maps its snapshot instead of parsing, FETCHMORE_NO_SNAPSHOT turns that off
+    if ( !qEnvironmentVariableIsSet( "FETCHMORE_NO_SNAPSHOT" ) )
+        fModel->setSnapshotDirectory( QStandardPaths::writableLocation( QStandardPaths::CacheLocation ) );
+    // the tester re-walks the model on every change, FETCHMORE_CHECK samples instead,
+    // its value is the budget per change in microseconds
+    if ( qEnvironmentVariableIsSet( "FETCHMORE_CHECK" ) )
+    {
+        fChecker = new ModelChecker( fModel, this );
+        bool aOK = false;
+        auto budget = qEnvironmentVariableIntValue( "FETCHMORE_CHECK", &aOK );
+        if ( aOK )
+            fChecker->setBudget( budget );
+    }
+    //new QAbstractItemModelTester( fModel, QAbstractItemModelTester::FailureReportingMode::Fatal, this );
+    // only lazily loaded items can be evicted, so a memory limit loads lazily
+    auto memoryLimitMB = qEnvironmentVariableIntValue( "FETCHMORE_MEMORY_LIMIT_MB" );
+    fModel->loadFile( ":/default.txt", ( memoryLimitMB > 0 ) ? TreeModel::ELoadMode::eLazy : TreeModel::ELoadMode::eImmediate );
+
+    // filtering and sorting go through the search index, so unfetched rows take part,
+    // the index is only built once a filter is typed
+    fFilterModel = new TreeFilterModel( this );
+
+    auto central = new QWidget( this );
+    fFilterEdit = new QLineEdit( central );
+    fFilterEdit->setPlaceholderText( tr( "Filter" ) );
+    fFilterEdit->setClearButtonEnabled( true );
+    connect( fFilterEdit, &QLineEdit::textChanged, this, &MainWindow::setFilterText );
+
+    fView = new QTreeView( central );
+    // ahead of the auto fetch helper so its stall count sees the view run dry;
+    // set FETCHMORE_NO_PREFETCH to count the stalls without prefetching
+    fPrefetcher = new ScrollPrefetcher( fView );
+    fPrefetcher->setEnabled( !qEnvironmentVariableIsSet( "FETCHMORE_NO_PREFETCH" ) );
+    new NQtUtils::CAutoFetchMore( fView );
+    fView->setModel( fModel );
+
+    auto layout = new QVBoxLayout( central );
+    layout->setContentsMargins( 0, 0, 0, 0 );
+    layout->addWidget( fFilterEdit );
+    layout->addWidget( fView );
+    setCentralWidget( central );
+    // FETCHMORE_MEMORY_LIMIT_MB bounds the rows below the viewport and under long
+    // collapsed nodes, rows above the viewport stay (see RowEvictor)
+    if ( memoryLimitMB > 0 )
+    {
+        fEvictor = new RowEvictor( fView );
+        fEvictor->setMemoryLimit( memoryLimitMB * Q_INT64_C( 1024 * 1024 ) );
+    }
+
+    fView->setContextMenuPolicy( Qt::ActionsContextMenu );
+    auto expandAllAction = new QAction( tr( "Expand All" ), fView );
+    connect( expandAllAction, &QAction::triggered, this, [ this ]() { expandAll(); } );
+    fView->addAction( expandAllAction );
+    auto expandSubtreeAction = new QAction( tr( "Expand Subtree" ), fView );
+    connect( expandSubtreeAction, &QAction::triggered, this, [ this ]() { expandAll( fView->currentIndex() ); } );
+    fView->addAction( expandSubtreeAction );
+    auto showInTreeAction = new QAction( tr( "Show in Tree" ), fView );
+    connect( showInTreeAction, &QAction::triggered, this, [ this ]() { showInTree( fView->currentIndex() ); } );
+    fView->addAction( showInTreeAction );
+
+    auto separator = new QAction( fView );
+    separator->setSeparator( true );
+    fView->addAction( separator );
+    auto collectStatsAction = new QAction( tr( "Collect Statistics" ), fView );
+    collectStatsAction->setCheckable( true );
+    collectStatsAction->setChecked( fModel->stats().isEnabled() );
+    connect( collectStatsAction, &QAction::toggled, this, [ this ]( bool checked ) { fModel->stats().setEnabled( checked ); } );
+    fView->addAction( collectStatsAction );
+    auto dumpStatsAction = new QAction( tr( "Dump Statistics" ), fView );
+    connect( dumpStatsAction, &QAction::triggered, this, &MainWindow::dumpStats );
+    fView->addAction( dumpStatsAction );
+    fView->show();
+
+    fView->installEventFilter( this );
+}
+
+MainWindow::~MainWindow()
+{
+    if ( fModel->stats().isEnabled() || fChecker )
+        dumpStats();
+}
+
+QString MainWindow::statsReport() const
+{
+    auto retVal = fModel->stats().dump( "TreeModel" );
+    retVal += QString( "\nScrollPrefetcher\n  stalls: %1\n  prefetches: %2" ).arg( fPrefetcher->stallCount() ).arg( fPrefetcher->prefetchCount() );
+    auto intern = fModel->internStats();
+    retVal += QString( "\nStringTable\n  hit rate: %1%\n  strings: %2\n  pool: %3 KB\n  decodes avoided: %4" )
+        .arg( intern.hitRate() * 100.0, 0, 'f', 1 )
+        .arg( intern.strings )
+        .arg( intern.poolBytes / 1024 )
+        .arg( intern.decodesAvoided );
+    if ( fChecker )
+        retVal += "\n" + fChecker->report();
+    if ( fEvictor )
+        retVal += "\n" + fEvictor->report();
+    return retVal;
+}
+
+void MainWindow::dumpStats()
+{
+    qDebug().noquote() << statsReport();
+}
+
+// The model shows the whole subtree first, one insert per parent the view already
+// shows, so the view finds nothing left to fetch and expands without a round trip per node
+void MainWindow::expandAll( const QModelIndex & index )
+{
+    if ( fView->model() == fModel )
+        fModel->fetchSubtree( index );
+    if ( !index.isValid() )
+    {
+        fView->expandAll();
+        return;
+    }
+
+    QSignalBlocker blocker( fView ); // no expanded() per node
+    fView->expandRecursively( index );
+}
+
+void MainWindow::expandToDepth( int depth )
+{
+    // expandToDepth( 0 ) expands the top level rows, which shows two levels
+    if ( fView->model() == fModel )
+        fModel->fetchSubtree( QModelIndex(), depth + 2 );
+    fView->expandToDepth( depth );
+}
+
+// The view only switches models when filtering starts or stops. Sorting by a
+// header click is offered on the filter model alone since it is the one that
+// sorts, it starts out in file order.
+void MainWindow::setFilterText( const QString & text )
+{
+    if ( !text.isEmpty() && !fFilterModel->sourceModel() )
+        fFilterModel->setSourceModel( fModel );
+    fFilterModel->setFilterText( text );
+    QAbstractItemModel * model = text.isEmpty() ? static_cast< QAbstractItemModel * >( fModel ) : fFilterModel;
+    if ( fView->model() == model )
+        return;
+
+    fView->setModel( model );
+    if ( model == fFilterModel )
+        fView->header()->setSortIndicator( -1, Qt::AscendingOrder );
+    fView->setSortingEnabled( model == fFilterModel );
+    if ( model == fModel )
+        fFilterModel->sort( -1 );
+}
+
+// Revealing fetches just the source rows on the path, the filter is cleared
+// afterwards so the row shows up in place
+void MainWindow::showInTree( const QModelIndex & index )
+{
+    if ( !index.isValid() || ( index.model() != fFilterModel ) )
+        return;
+
+    QPersistentModelIndex sourceIndex = fFilterModel->revealInSource( index );
+    fFilterEdit->clear();
+    if ( !sourceIndex.isValid() )
+        return;
+
+    for ( auto parent = sourceIndex.parent(); parent.isValid(); parent = parent.parent() )
+        fView->expand( parent );
+    fView->setCurrentIndex( sourceIndex );
+    fView->scrollTo( sourceIndex );
+}
+
+bool MainWindow::eventFilter( QObject * obj, QEvent * event )
+{
+    if ( ( obj == fView ) && ( event->type() == QEvent::Resize ) )
+    {
+        auto rowHeight = qMax( fView->fontMetrics().height(), fView->sizeHintForRow( 0 ) );
+        fModel->fetchPolicy().setViewportHeight( fView->viewport()->height(), rowHeight );
+        fFilterModel->fetchPolicy().setViewportHeight( fView->viewport()->height(), rowHeight );
+    }
+    return QMainWindow::eventFilter( obj, event );
+}
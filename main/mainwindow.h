@@ -0,0 +1,45 @@
+
+#ifndef MAINWINDOW_H
+#define MAINWINDOW_H
+
+#include <QMainWindow>
+#include <QModelIndex>
+
+class QTreeView;
+class QLineEdit;
+class TreeModel;
+class TreeFilterModel;
+class ScrollPrefetcher;
+class RowEvictor;
+class ModelChecker;
+
+class MainWindow : public QMainWindow
+{
+    Q_OBJECT
+private:
+public:
+    MainWindow(QWidget *parent = NULL);
+    virtual ~MainWindow();
+
+    virtual bool eventFilter( QObject * obj, QEvent * event ) override;
+
+    QString statsReport() const; // model traffic, fetch batches, prefetch stalls, interning, checker and eviction counters as text
+
+public slots:
+    void expandAll( const QModelIndex & index = QModelIndex() );
+    void expandToDepth( int depth ); // QTreeView::expandToDepth, fetched in one step
+    void dumpStats(); // statsReport() to the debug output
+    void setFilterText( const QString & text ); // shows the filter model while the text is not empty
+    void showInTree( const QModelIndex & index ); // a filtered row, revealed in the unfiltered tree
+
+private:
+    QTreeView * fView;
+    TreeModel * fModel;
+    TreeFilterModel * fFilterModel;
+    QLineEdit * fFilterEdit;
+    ScrollPrefetcher * fPrefetcher;
+    ModelChecker * fChecker{ nullptr };
+    RowEvictor * fEvictor{ nullptr };
+};
+
+#endif
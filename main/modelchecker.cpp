@@ -0,0 +1,201 @@
+
+#include "modelchecker.h"
+
+#include <QAbstractItemModel>
+#include <QStringList>
+#include <QDebug>
+
+namespace
+{
+    const int kMaxWalkDepth = 64;
+
+    QString describe( const QModelIndex & index )
+    {
+        QStringList rows;
+        auto curr = index;
+        for ( int depth = 0; curr.isValid() && ( depth < kMaxWalkDepth ); ++depth, curr = curr.parent() )
+            rows.prepend( QString::number( curr.row() ) );
+        return QString( "[%1] column %2" ).arg( rows.join( "/" ) ).arg( index.column() );
+    }
+}
+
+ModelChecker::ModelChecker( QAbstractItemModel * model, QObject * parent )
+    : QObject( parent ),
+    fModel( model ),
+    fRandom( QRandomGenerator::global()->generate() )
+{
+    connect( fModel, &QAbstractItemModel::rowsAboutToBeInserted, this, [ this ]( const QModelIndex & parent, int first, int last ) { aboutToChangeRows( parent, first, last, true ); } );
+    connect( fModel, &QAbstractItemModel::rowsInserted, this, &ModelChecker::rowsChanged );
+    connect( fModel, &QAbstractItemModel::rowsAboutToBeRemoved, this, [ this ]( const QModelIndex & parent, int first, int last ) { aboutToChangeRows( parent, first, last, false ); } );
+    connect( fModel, &QAbstractItemModel::rowsRemoved, this, [ this ]( const QModelIndex & parent, int first, int /*last*/ )
+    {
+        // the removed rows are gone, look at the ones that moved up into their place
+        rowsChanged( parent, first, first );
+    } );
+    connect( fModel, &QAbstractItemModel::dataChanged, this, &ModelChecker::dataChanged );
+    connect( fModel, &QAbstractItemModel::rowsMoved, this, &ModelChecker::checkSample );
+    connect( fModel, &QAbstractItemModel::layoutChanged, this, &ModelChecker::checkSample );
+    connect( fModel, &QAbstractItemModel::modelReset, this, [ this ]()
+    {
+        fPending.clear();
+        checkSample();
+    } );
+}
+
+void ModelChecker::setBudget( int usecs )
+{
+    fBudgetUS = qMax( 0, usecs );
+}
+
+void ModelChecker::setSampleSize( int rows )
+{
+    fSampleSize = qMax( 1, rows );
+}
+
+void ModelChecker::resetCounters()
+{
+    fCounters = Counters();
+    fLastFailure.clear();
+}
+
+QString ModelChecker::report() const
+{
+    auto retVal = QString( "ModelChecker\n  transactions: %1\n  rows checked: %2\n  failures: %3\n  over budget: %4" )
+        .arg( fCounters.transactions ).arg( fCounters.rowsChecked ).arg( fCounters.failures ).arg( fCounters.overBudget );
+    if ( !fLastFailure.isEmpty() )
+        retVal += "\n  last failure: " + fLastFailure;
+    return retVal;
+}
+
+void ModelChecker::checkSample()
+{
+    beginTransaction();
+    randomWalks();
+    endTransaction();
+}
+
+void ModelChecker::aboutToChangeRows( const QModelIndex & parent, int first, int last, bool inserting )
+{
+    auto count = last - first + 1;
+    fPending.append( { parent, fModel->rowCount( parent ), inserting ? count : -count } );
+}
+
+// the row count check is exact, the rows themselves are sampled
+void ModelChecker::rowsChanged( const QModelIndex & parent, int first, int last )
+{
+    beginTransaction();
+    if ( !fPending.isEmpty() )
+    {
+        auto pending = fPending.takeLast();
+        check( pending.parent == parent, "rows signalled under another parent than announced", parent );
+        check( fModel->rowCount( parent ) == pending.rowCount + pending.delta, "row count does not match the rows announced", parent );
+    }
+    else
+        check( false, "rows changed without being announced", parent );
+
+    checkRows( parent, first, qMin( last, fModel->rowCount( parent ) - 1 ) );
+    randomWalks();
+    endTransaction();
+}
+
+void ModelChecker::dataChanged( const QModelIndex & topLeft, const QModelIndex & bottomRight )
+{
+    beginTransaction();
+    if ( check( topLeft.isValid() && bottomRight.isValid(), "dataChanged with an invalid index", topLeft )
+         && check( topLeft.parent() == bottomRight.parent(), "dataChanged across parents", topLeft )
+         && check( ( topLeft.row() <= bottomRight.row() ) && ( topLeft.column() <= bottomRight.column() ), "dataChanged range is inverted", topLeft ) )
+        checkRows( topLeft.parent(), topLeft.row(), bottomRight.row() );
+    randomWalks();
+    endTransaction();
+}
+
+void ModelChecker::beginTransaction()
+{
+    fCounters.transactions++;
+    fChecked = 0;
+    fTimer.start();
+}
+
+void ModelChecker::endTransaction()
+{
+    if ( !inBudget() && ( fChecked < fSampleSize ) )
+        fCounters.overBudget++;
+}
+
+bool ModelChecker::inBudget()
+{
+    return fTimer.nsecsElapsed() < fBudgetUS * qint64( 1000 );
+}
+
+// the first and last rows, then random ones in between
+void ModelChecker::checkRows( const QModelIndex & parent, int first, int last )
+{
+    if ( last < first )
+        return;
+
+    int columns = qMax( 1, fModel->columnCount( parent ) );
+    for ( int ii = 0; ( ii < ( last - first + 1 ) ) && ( fChecked < fSampleSize ) && inBudget(); ++ii )
+    {
+        int row = first;
+        if ( ii == 1 )
+            row = last;
+        else if ( ii > 1 )
+            row = first + fRandom.bounded( last - first + 1 );
+        checkIndex( fModel->index( row, fRandom.bounded( columns ), parent ) );
+    }
+}
+
+// down from the root to a leaf, or to a row whose children are not fetched
+void ModelChecker::randomWalks()
+{
+    while ( ( fChecked < fSampleSize ) && inBudget() )
+    {
+        QModelIndex parent;
+        auto rows = fModel->rowCount( parent );
+        if ( rows <= 0 )
+            return;
+        for ( int depth = 0; ( rows > 0 ) && ( depth < kMaxWalkDepth ) && ( fChecked < fSampleSize ); ++depth )
+        {
+            auto index = fModel->index( fRandom.bounded( rows ), 0, parent );
+            if ( !checkIndex( index ) )
+                break;
+            parent = index;
+            rows = fModel->rowCount( parent );
+        }
+    }
+}
+
+bool ModelChecker::checkIndex( const QModelIndex & index )
+{
+    fChecked++;
+    fCounters.rowsChecked++;
+    if ( !check( index.isValid() && ( index.model() == fModel ), "index() returned an invalid index for a row in range", index ) )
+        return false;
+
+    auto parent = fModel->parent( index );
+    bool retVal = check( fModel->index( index.row(), index.column(), parent ) == index, "index( row, column, parent( index ) ) does not round trip", index )
+        && check( index.row() < fModel->rowCount( parent ), "row is not below its parent's row count", index )
+        && check( index.column() < fModel->columnCount( parent ), "column is not below its parent's column count", index )
+        && check( fModel->sibling( index.row(), 0, index ) == fModel->index( index.row(), 0, parent ), "sibling() disagrees with index()", index );
+    if ( !retVal )
+        return false;
+
+    fModel->data( index, Qt::DisplayRole );
+    fModel->flags( index );
+    if ( index.column() == 0 )
+        retVal = check( ( fModel->rowCount( index ) <= 0 ) || fModel->hasChildren( index ), "rows below an index without children", index );
+    return retVal;
+}
+
+bool ModelChecker::check( bool condition, const char * what, const QModelIndex & index )
+{
+    if ( condition )
+        return true;
+
+    fCounters.failures++;
+    fLastFailure = QString( "%1 at %2" ).arg( what ).arg( describe( index ) );
+    if ( fFatal )
+        qFatal( "ModelChecker: %s", qPrintable( fLastFailure ) );
+    qWarning().noquote() << "ModelChecker:" << fLastFailure;
+    return false;
+}
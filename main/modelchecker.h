@@ -0,0 +1,83 @@
+
+#ifndef MODELCHECKER_H
+#define MODELCHECKER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QPersistentModelIndex>
+#include <QRandomGenerator>
+#include <QString>
+#include <QVector>
+
+class QAbstractItemModel;
+
+// A sampling stand in for QAbstractItemModelTester on models too big to re-walk.
+// After each transaction (rows inserted, removed or moved, data or layout
+// changed, reset) it checks rows until its time budget runs out: a sample of
+// the rows the transaction touched first, then random walks down from the root.
+// A checked row must round trip through parent() and index(), lie within its
+// parent's row and column counts and agree with hasChildren.
+// Row counts across begin/end pairs are checked on every transaction.
+// Nothing is fetched, so checking does not change what the model shows.
+class ModelChecker : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Counters
+    {
+        quint64 transactions{ 0 };
+        quint64 rowsChecked{ 0 };
+        quint64 failures{ 0 };
+        quint64 overBudget{ 0 }; // transactions whose sample was cut short
+    };
+
+    ModelChecker( QAbstractItemModel * model, QObject * parent = nullptr );
+
+    void setBudget( int usecs ); // per transaction
+    int budget() const { return fBudgetUS; }
+    void setSampleSize( int rows ); // at most this many rows per transaction
+    int sampleSize() const { return fSampleSize; }
+    void setFatal( bool fatal ) { fFatal = fatal; } // qFatal on the first failure instead of counting it
+
+    const Counters & counters() const { return fCounters; }
+    QString lastFailure() const { return fLastFailure; }
+    void resetCounters();
+    QString report() const;
+
+public slots:
+    void checkSample(); // a transaction's worth of random walks, for idle time
+
+private:
+    struct Pending
+    {
+        QPersistentModelIndex parent;
+        int rowCount;
+        int delta;
+    };
+
+    void aboutToChangeRows( const QModelIndex & parent, int first, int last, bool inserting );
+    void rowsChanged( const QModelIndex & parent, int first, int last );
+    void dataChanged( const QModelIndex & topLeft, const QModelIndex & bottomRight );
+
+    void beginTransaction();
+    void endTransaction();
+    void checkRows( const QModelIndex & parent, int first, int last );
+    void randomWalks();
+    bool checkIndex( const QModelIndex & index );
+    bool check( bool condition, const char * what, const QModelIndex & index );
+    bool inBudget();
+
+    QAbstractItemModel * fModel;
+    QVector< Pending > fPending; // begin/end pairs still open
+    QRandomGenerator fRandom;
+    QElapsedTimer fTimer; // the current transaction
+    int fChecked{ 0 }; // rows in the current transaction
+    int fBudgetUS{ 200 };
+    int fSampleSize{ 32 };
+    bool fFatal{ false };
+    Counters fCounters;
+    QString fLastFailure;
+};
+
+#endif
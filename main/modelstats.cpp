@@ -0,0 +1,99 @@
+
+#include "modelstats.h"
+
+#include <QtAlgorithms>
+#include <QStringList>
+
+#include <algorithm>
+
+namespace
+{
+    const char * const kCallNames[] = { "index", "parent", "rowCount", "columnCount", "data", "hasChildren", "canFetchMore", "fetchMore" };
+    static_assert( sizeof( kCallNames ) / sizeof( kCallNames[ 0 ] ) == ModelStats::eCallCount, "a name for every ECall" );
+}
+
+void ModelStats::Histogram::add( quint64 value )
+{
+    int bucket = ( value == 0 ) ? 0 : ( 64 - static_cast< int >( qCountLeadingZeroBits( value ) ) );
+    fBuckets[ qMin( bucket, kBucketCount - 1 ) ]++;
+    fCount++;
+}
+
+void ModelStats::Histogram::clear()
+{
+    std::fill( fBuckets, fBuckets + kBucketCount, 0 );
+    fCount = 0;
+}
+
+// one line per non-empty bucket, "[lower, upper) unit: count"
+QString ModelStats::Histogram::toString( const QString & unit ) const
+{
+    QStringList retVal;
+    for ( int ii = 0; ii < kBucketCount; ++ii )
+    {
+        if ( !fBuckets[ ii ] )
+            continue;
+        quint64 lower = ( ii == 0 ) ? 0 : ( Q_UINT64_C( 1 ) << ( ii - 1 ) );
+        quint64 upper = ( ii == 0 ) ? 1 : ( Q_UINT64_C( 1 ) << ii );
+        retVal << QString( "    [%1, %2) %3: %4" ).arg( lower ).arg( upper ).arg( unit ).arg( fBuckets[ ii ] );
+    }
+    return retVal.join( "\n" );
+}
+
+void ModelStats::setEnabled( bool enabled )
+{
+    fEnabled = enabled;
+    if ( fEnabled )
+        fSinceEnabled.start();
+}
+
+void ModelStats::reset()
+{
+    std::fill( fCalls, fCalls + eCallCount, 0 );
+    fBatchSizes.clear();
+    fInsertTimes.clear();
+    fRowsRevealed = 0;
+    fLoads = 0;
+    fLoadNSecs = 0;
+    if ( fEnabled )
+        fSinceEnabled.start();
+}
+
+void ModelStats::recordInsert( int rows, qint64 nsecs )
+{
+    fBatchSizes.add( rows );
+    fInsertTimes.add( nsecs / 1000 );
+    fRowsRevealed += rows;
+}
+
+void ModelStats::recordLoad( qint64 nsecs )
+{
+    fLoads++;
+    fLoadNSecs += nsecs;
+}
+
+double ModelStats::rowsPerSecond() const
+{
+    if ( !fSinceEnabled.isValid() )
+        return 0.0;
+    auto secs = fSinceEnabled.nsecsElapsed() / 1e9;
+    return ( secs > 0 ) ? ( fRowsRevealed / secs ) : 0.0;
+}
+
+QString ModelStats::dump( const QString & title ) const
+{
+    QStringList retVal;
+    retVal << QString( "%1%2" ).arg( title ).arg( fEnabled ? "" : " (disabled)" );
+    retVal << "  calls:";
+    for ( int ii = 0; ii < eCallCount; ++ii )
+        retVal << QString( "    %1: %2" ).arg( kCallNames[ ii ] ).arg( fCalls[ ii ] );
+    retVal << QString( "  rows revealed: %1 (%2 per second)" ).arg( fRowsRevealed ).arg( rowsPerSecond(), 0, 'f', 1 );
+    retVal << QString( "  fetch batch sizes (%1 batches):" ).arg( fBatchSizes.count() );
+    if ( fBatchSizes.count() )
+        retVal << fBatchSizes.toString( "rows" );
+    retVal << "  beginInsertRows to endInsertRows:";
+    if ( fInsertTimes.count() )
+        retVal << fInsertTimes.toString( "us" );
+    retVal << QString( "  loads: %1, %2 ms" ).arg( fLoads ).arg( fLoadNSecs / 1000000 );
+    return retVal.join( "\n" );
+}
@@ -0,0 +1,73 @@
+
+#ifndef MODELSTATS_H
+#define MODELSTATS_H
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QtGlobal>
+
+// Opt-in counters for a model: calls per method, fetch batch sizes, the time
+// from beginInsertRows to endInsertRows, rows revealed per second and load times.
+// Disabled, every record call is an inline test of one bool.
+class ModelStats
+{
+public:
+    enum ECall
+    {
+        eIndex,
+        eParent,
+        eRowCount,
+        eColumnCount,
+        eData,
+        eHasChildren,
+        eCanFetchMore,
+        eFetchMore,
+        eCallCount
+    };
+
+    // power of two buckets, bucket n counts values in [ 2^(n-1), 2^n ), bucket 0 counts zeros
+    class Histogram
+    {
+    public:
+        static const int kBucketCount = 40;
+
+        void add( quint64 value );
+        void clear();
+        quint64 count() const { return fCount; }
+        quint64 bucket( int ii ) const { return fBuckets[ ii ]; }
+        QString toString( const QString & unit ) const;
+    private:
+        quint64 fBuckets[ kBucketCount ]{};
+        quint64 fCount{ 0 };
+    };
+
+    void setEnabled( bool enabled ); // enabling restarts the clock for the per second rates
+    bool isEnabled() const { return fEnabled; }
+    void reset();
+
+    void count( ECall call ) { if ( fEnabled ) fCalls[ call ]++; }
+    void rowsInserted( int rows, qint64 nsecs ) { if ( fEnabled ) recordInsert( rows, nsecs ); }
+    void loaded( qint64 nsecs ) { if ( fEnabled ) recordLoad( nsecs ); }
+
+    quint64 calls( ECall call ) const { return fCalls[ call ]; }
+    const Histogram & batchSizes() const { return fBatchSizes; }
+    const Histogram & insertTimes() const { return fInsertTimes; } // microseconds
+    quint64 rowsRevealed() const { return fRowsRevealed; }
+    double rowsPerSecond() const;
+
+    QString dump( const QString & title ) const;
+private:
+    void recordInsert( int rows, qint64 nsecs );
+    void recordLoad( qint64 nsecs );
+
+    bool fEnabled{ false };
+    QElapsedTimer fSinceEnabled;
+    quint64 fCalls[ eCallCount ]{};
+    Histogram fBatchSizes;
+    Histogram fInsertTimes;
+    quint64 fRowsRevealed{ 0 };
+    quint64 fLoads{ 0 };
+    qint64 fLoadNSecs{ 0 };
+};
+
+#endif
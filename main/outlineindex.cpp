@@ -0,0 +1,65 @@
+
+#include "outlineindex.h"
+#include "outlinescanner.h"
+
+#include <QVarLengthArray>
+
+void OutlineIndex::build( OutlineScanner & scanner )
+{
+    clear();
+
+    // openLines[ depth ] is the last line seen at that depth whose subtree is still open
+    QVarLengthArray< int, 32 > openLines;
+    while ( scanner.next() )
+    {
+        int line = fOffsets.count();
+
+        // same clamping as TreeModel::setupModelData, at most one level below the previous line
+        auto depth = qMin( scanner.depth(), openLines.size() );
+        while ( openLines.size() > depth )
+        {
+            fSubtreeEnd[ openLines.back() ] = line;
+            openLines.removeLast();
+        }
+
+        if ( depth == 0 )
+            fTopLevelCount++;
+        else
+            fChildCount[ openLines.back() ]++;
+
+        fOffsets.append( scanner.lineOffset() );
+        fSubtreeEnd.append( line + 1 );
+        fChildCount.append( 0 );
+        openLines.append( line );
+    }
+
+    for ( auto && line : openLines )
+        fSubtreeEnd[ line ] = fOffsets.count();
+
+    fOffsetData = fOffsets.constData();
+    fSubtreeEndData = fSubtreeEnd.constData();
+    fChildCountData = fChildCount.constData();
+    fLineCount = fOffsets.count();
+}
+
+void OutlineIndex::adopt( const qint64 * offsets, const int * subtreeEnd, const int * childCount, int lineCount, int topLevelCount )
+{
+    clear();
+    fOffsetData = offsets;
+    fSubtreeEndData = subtreeEnd;
+    fChildCountData = childCount;
+    fLineCount = lineCount;
+    fTopLevelCount = topLevelCount;
+}
+
+void OutlineIndex::clear()
+{
+    fOffsets.clear();
+    fSubtreeEnd.clear();
+    fChildCount.clear();
+    fOffsetData = nullptr;
+    fSubtreeEndData = nullptr;
+    fChildCountData = nullptr;
+    fLineCount = 0;
+    fTopLevelCount = 0;
+}
@@ -0,0 +1,46 @@
+
+#ifndef OUTLINEINDEX_H
+#define OUTLINEINDEX_H
+
+#include <QVector>
+
+class OutlineScanner;
+
+// Line offsets and subtree boundaries of an outline, built in one scan.
+// The children of line N start at N + 1 and each one is followed by the
+// sibling at its subtreeEnd. Line -1 is the invisible root.
+// The arrays are either owned or, after adopt, borrowed from a snapshot mapping.
+class OutlineIndex
+{
+public:
+    void build( OutlineScanner & scanner );
+    void adopt( const qint64 * offsets, const int * subtreeEnd, const int * childCount, int lineCount, int topLevelCount );
+    void clear();
+
+    bool isEmpty() const { return fLineCount == 0; }
+    int lineCount() const { return fLineCount; }
+    int topLevelCount() const { return fTopLevelCount; }
+
+    qint64 offset( int line ) const { return fOffsetData[ line ]; }
+    int subtreeEnd( int line ) const { return ( line < 0 ) ? lineCount() : fSubtreeEndData[ line ]; }
+    int childCount( int line ) const { return ( line < 0 ) ? fTopLevelCount : fChildCountData[ line ]; }
+    int firstChild( int line ) const { return line + 1; }
+    int nextSibling( int line ) const { return fSubtreeEndData[ line ]; }
+
+    // the whole arrays, lineCount entries each
+    const qint64 * offsetData() const { return fOffsetData; }
+    const int * subtreeEndData() const { return fSubtreeEndData; }
+    const int * childCountData() const { return fChildCountData; }
+private:
+    QVector< qint64 > fOffsets;
+    QVector< int > fSubtreeEnd;
+    QVector< int > fChildCount;
+
+    const qint64 * fOffsetData{ nullptr };
+    const int * fSubtreeEndData{ nullptr };
+    const int * fChildCountData{ nullptr };
+    int fLineCount{ 0 };
+    int fTopLevelCount{ 0 };
+};
+
+#endif
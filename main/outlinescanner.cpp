@@ -0,0 +1,60 @@
+
+#include "outlinescanner.h"
+
+#include <cstring>
+
+OutlineScanner::OutlineScanner( const char * data, qint64 size ) :
+    fBegin( data ),
+    fEnd( data + size ),
+    fPos( data ),
+    fLineBegin( data )
+{
+}
+
+OutlineScanner::OutlineScanner( const char * data, qint64 begin, qint64 end ) :
+    fBegin( data ),
+    fEnd( data + end ),
+    fPos( data + begin ),
+    fLineBegin( data + begin )
+{
+}
+
+OutlineScanner::OutlineScanner( const QByteArray & data ) :
+    OutlineScanner( data.constData(), data.size() )
+{
+}
+
+// memchr is vectorized by the C runtime, so both the line and column
+// searches run over the raw bytes without a per character loop
+bool OutlineScanner::next()
+{
+    while ( fPos < fEnd )
+    {
+        fLineBegin = fPos;
+        auto lineEnd = static_cast< const char * >( std::memchr( fPos, '\n', fEnd - fPos ) );
+        if ( lineEnd )
+            fPos = lineEnd + 1;
+        else
+            fPos = lineEnd = fEnd;
+
+        auto curr = fLineBegin;
+        while ( ( curr < lineEnd ) && ( *curr == '\t' ) )
+            ++curr;
+        fDepth = static_cast< int >( curr - fLineBegin );
+
+        fColumns.resize( 0 );
+        while ( curr < lineEnd )
+        {
+            auto tab = static_cast< const char * >( std::memchr( curr, '\t', lineEnd - curr ) );
+            if ( !tab )
+                tab = lineEnd;
+            if ( tab > curr )
+                fColumns.append( { curr, static_cast< int >( tab - curr ) } );
+            curr = tab + 1;
+        }
+
+        if ( !fColumns.isEmpty() )
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,47 @@
+
+#ifndef OUTLINESCANNER_H
+#define OUTLINESCANNER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVarLengthArray>
+
+// A column of the current line, pointing into the scanned buffer
+struct OutlineColumn
+{
+    QString toString() const { return QString::fromUtf8( data, size ); }
+
+    const char * data{ nullptr };
+    int size{ 0 };
+};
+
+// Single pass scanner over tab indented UTF-8 outline text.
+// Leading tabs give the depth, remaining tabs separate columns and empty
+// columns are dropped. Nothing is copied, the buffer must outlive the scanner.
+class OutlineScanner
+{
+public:
+    OutlineScanner( const char * data, qint64 size );
+    OutlineScanner( const char * data, qint64 begin, qint64 end ); // scans [begin, end), offsets stay relative to data
+    explicit OutlineScanner( const QByteArray & data );
+
+    bool next(); // advances to the next line with at least one column
+
+    int depth() const { return fDepth; }
+    int columnCount() const { return fColumns.size(); }
+    const OutlineColumn & column( int ii ) const { return fColumns[ ii ]; }
+
+    const char * data() const { return fBegin; }
+    qint64 lineOffset() const { return fLineBegin - fBegin; }
+    qint64 position() const { return fPos - fBegin; }
+    qint64 size() const { return fEnd - fBegin; }
+private:
+    const char * fBegin{ nullptr };
+    const char * fEnd{ nullptr };
+    const char * fPos{ nullptr };
+    const char * fLineBegin{ nullptr };
+    int fDepth{ 0 };
+    QVarLengthArray< OutlineColumn, 8 > fColumns;
+};
+
+#endif
@@ -0,0 +1,230 @@
+
+#include "outlinesnapshot.h"
+#include "outlineindex.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+
+#include <cstring>
+
+namespace
+{
+    const char kMagic[ 8 ] = { 'F', 'M', 'O', 'U', 'T', 'L', 'N', 'S' };
+    const quint32 kVersion = 2;
+    const quint32 kByteOrder = 0x01020304; // written natively, a snapshot from another byte order does not match
+
+    // followed by offsets[ lineCount ], subtreeEnd[ lineCount ], childCount[ lineCount ],
+    // then at shownPos a qint32 count and that many ( line, count ) qint32 pairs
+    struct Header
+    {
+        char magic[ 8 ];
+        quint32 version;
+        quint32 byteOrder;
+        quint64 sourceHash;
+        qint64 sourceSize;
+        qint64 sourceModified;
+        qint32 lineCount;
+        qint32 topLevelCount;
+        qint64 shownPos;
+    };
+    static_assert( sizeof( Header ) % sizeof( qint64 ) == 0, "the offsets after the header stay aligned" );
+
+    qint64 shownPosFor( qint64 lineCount )
+    {
+        return sizeof( Header ) + lineCount * ( sizeof( qint64 ) + 2 * sizeof( qint32 ) );
+    }
+}
+
+// MurmurHash64A, one pass of 8 byte words; this is a cache key not a checksum
+quint64 OutlineSnapshot::hashSource( const char * data, qint64 size )
+{
+    const quint64 kMultiplier = Q_UINT64_C( 0xc6a4a7935bd1e995 );
+    const int kShift = 47;
+
+    quint64 retVal = Q_UINT64_C( 0x9e3779b97f4a7c15 ) ^ ( static_cast< quint64 >( size ) * kMultiplier );
+    auto end = data + ( size & ~qint64( 7 ) );
+    for ( auto pos = data; pos != end; pos += 8 )
+    {
+        quint64 word;
+        std::memcpy( &word, pos, sizeof( word ) );
+        word *= kMultiplier;
+        word ^= word >> kShift;
+        word *= kMultiplier;
+        retVal ^= word;
+        retVal *= kMultiplier;
+    }
+
+    if ( size & 7 )
+    {
+        quint64 word = 0;
+        std::memcpy( &word, end, size & 7 );
+        retVal ^= word;
+        retVal *= kMultiplier;
+    }
+
+    retVal ^= retVal >> kShift;
+    retVal *= kMultiplier;
+    retVal ^= retVal >> kShift;
+    return retVal;
+}
+
+// written to a temporary name and renamed, a reader never sees a partial snapshot
+bool OutlineSnapshot::write( const QString & path, quint64 sourceHash, qint64 sourceSize, qint64 sourceModified, const OutlineIndex & index )
+{
+    QDir().mkpath( QFileInfo( path ).absolutePath() );
+    auto tmpPath = path + ".tmp";
+    QFile file( tmpPath );
+    if ( !file.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
+        return false;
+
+    Header header;
+    std::memcpy( header.magic, kMagic, sizeof( kMagic ) );
+    header.version = kVersion;
+    header.byteOrder = kByteOrder;
+    header.sourceHash = sourceHash;
+    header.sourceSize = sourceSize;
+    header.sourceModified = sourceModified;
+    header.lineCount = index.lineCount();
+    header.topLevelCount = index.topLevelCount();
+    header.shownPos = shownPosFor( index.lineCount() );
+
+    qint32 shownCount = 0;
+    auto lineCount = static_cast< qint64 >( index.lineCount() );
+    bool aOK = ( file.write( reinterpret_cast< const char * >( &header ), sizeof( header ) ) == sizeof( header ) )
+        && ( file.write( reinterpret_cast< const char * >( index.offsetData() ), lineCount * sizeof( qint64 ) ) == lineCount * qint64( sizeof( qint64 ) ) )
+        && ( file.write( reinterpret_cast< const char * >( index.subtreeEndData() ), lineCount * sizeof( qint32 ) ) == lineCount * qint64( sizeof( qint32 ) ) )
+        && ( file.write( reinterpret_cast< const char * >( index.childCountData() ), lineCount * sizeof( qint32 ) ) == lineCount * qint64( sizeof( qint32 ) ) )
+        && ( file.write( reinterpret_cast< const char * >( &shownCount ), sizeof( shownCount ) ) == sizeof( shownCount ) );
+    file.close();
+
+    QFile::remove( path );
+    if ( !aOK || !QFile::rename( tmpPath, path ) )
+    {
+        QFile::remove( tmpPath );
+        return false;
+    }
+    return true;
+}
+
+// only the tail after the index arrays is rewritten
+bool OutlineSnapshot::writeShownCounts( const QString & path, const ShownCounts & shownCounts )
+{
+    QFile file( path );
+    if ( !file.open( QIODevice::ReadWrite ) )
+        return false;
+
+    Header header;
+    if ( ( file.read( reinterpret_cast< char * >( &header ), sizeof( header ) ) != sizeof( header ) )
+         || ( std::memcmp( header.magic, kMagic, sizeof( kMagic ) ) != 0 ) || ( header.version != kVersion ) || ( header.byteOrder != kByteOrder )
+         || ( header.shownPos != shownPosFor( header.lineCount ) ) )
+        return false;
+
+    QVector< qint32 > tail;
+    tail.reserve( 1 + 2 * shownCounts.count() );
+    tail << shownCounts.count();
+    for ( auto && shown : shownCounts )
+        tail << shown.first << shown.second;
+
+    auto bytes = static_cast< qint64 >( tail.count() * sizeof( qint32 ) );
+    return file.resize( header.shownPos + bytes ) && file.seek( header.shownPos )
+        && ( file.write( reinterpret_cast< const char * >( tail.constData() ), bytes ) == bytes );
+}
+
+// only the header is rewritten
+bool OutlineSnapshot::writeSourceModified( const QString & path, qint64 sourceModified )
+{
+    QFile file( path );
+    if ( !file.open( QIODevice::ReadWrite ) )
+        return false;
+
+    Header header;
+    if ( ( file.read( reinterpret_cast< char * >( &header ), sizeof( header ) ) != sizeof( header ) )
+         || ( std::memcmp( header.magic, kMagic, sizeof( kMagic ) ) != 0 ) || ( header.version != kVersion ) || ( header.byteOrder != kByteOrder ) )
+        return false;
+
+    header.sourceModified = sourceModified;
+    return file.seek( 0 ) && ( file.write( reinterpret_cast< const char * >( &header ), sizeof( header ) ) == sizeof( header ) );
+}
+
+OutlineSnapshot::OutlineSnapshot()
+{
+}
+
+OutlineSnapshot::~OutlineSnapshot()
+{
+}
+
+bool OutlineSnapshot::open( const QString & path )
+{
+    close();
+
+    auto file = std::make_unique< QFile >( path );
+    if ( !file->open( QIODevice::ReadOnly ) || ( file->size() < static_cast< qint64 >( sizeof( Header ) ) ) )
+        return false;
+
+    auto size = file->size();
+    auto data = file->map( 0, size );
+    if ( !data )
+        return false;
+
+    auto header = reinterpret_cast< const Header * >( data );
+    if ( ( std::memcmp( header->magic, kMagic, sizeof( kMagic ) ) != 0 ) || ( header->version != kVersion ) || ( header->byteOrder != kByteOrder )
+         || ( header->lineCount < 0 ) || ( header->shownPos != shownPosFor( header->lineCount ) )
+         || ( size < header->shownPos + static_cast< qint64 >( sizeof( qint32 ) ) ) )
+        return false;
+
+    auto shownCount = *reinterpret_cast< const qint32 * >( data + header->shownPos );
+    if ( ( shownCount < 0 ) || ( size < header->shownPos + static_cast< qint64 >( ( 1 + 2 * qint64( shownCount ) ) * sizeof( qint32 ) ) ) )
+        return false;
+
+    fFile = std::move( file );
+    fData = data;
+    fSize = size;
+    return true;
+}
+
+void OutlineSnapshot::close()
+{
+    fFile.reset();
+    fData = nullptr;
+    fSize = 0;
+}
+
+quint64 OutlineSnapshot::sourceHash() const
+{
+    return fData ? reinterpret_cast< const Header * >( fData )->sourceHash : 0;
+}
+
+qint64 OutlineSnapshot::sourceSize() const
+{
+    return fData ? reinterpret_cast< const Header * >( fData )->sourceSize : -1;
+}
+
+qint64 OutlineSnapshot::sourceModified() const
+{
+    return fData ? reinterpret_cast< const Header * >( fData )->sourceModified : -1;
+}
+
+void OutlineSnapshot::adoptInto( OutlineIndex & index ) const
+{
+    auto header = reinterpret_cast< const Header * >( fData );
+    auto offsets = reinterpret_cast< const qint64 * >( fData + sizeof( Header ) );
+    auto subtreeEnd = reinterpret_cast< const qint32 * >( offsets + header->lineCount );
+    auto childCount = subtreeEnd + header->lineCount;
+    index.adopt( offsets, subtreeEnd, childCount, header->lineCount, header->topLevelCount );
+}
+
+OutlineSnapshot::ShownCounts OutlineSnapshot::shownCounts() const
+{
+    ShownCounts retVal;
+    if ( !fData )
+        return retVal;
+
+    auto header = reinterpret_cast< const Header * >( fData );
+    auto tail = reinterpret_cast< const qint32 * >( fData + header->shownPos );
+    retVal.reserve( tail[ 0 ] );
+    for ( int ii = 0; ii < tail[ 0 ]; ++ii )
+        retVal << qMakePair( tail[ 1 + 2 * ii ], tail[ 2 + 2 * ii ] );
+    return retVal;
+}
@@ -0,0 +1,49 @@
+
+#ifndef OUTLINESNAPSHOT_H
+#define OUTLINESNAPSHOT_H
+
+#include <QString>
+#include <QVector>
+#include <QPair>
+
+#include <memory>
+
+class OutlineIndex;
+class QFile;
+
+// A versioned binary image of an OutlineIndex and the shown child counts of a
+// tree, keyed by the size, modification time and a hash of the source text.
+// Opening maps it read only and the index arrays are used in place, so a reopen
+// costs page faults rather than a scan.
+// Shown counts are ( line, count ) pairs in pre-order, line -1 is the root.
+class OutlineSnapshot
+{
+public:
+    using ShownCounts = QVector< QPair< int, int > >;
+
+    static quint64 hashSource( const char * data, qint64 size );
+    static bool write( const QString & path, quint64 sourceHash, qint64 sourceSize, qint64 sourceModified, const OutlineIndex & index );
+    static bool writeShownCounts( const QString & path, const ShownCounts & shownCounts ); // replaces the ones in the file
+    static bool writeSourceModified( const QString & path, qint64 sourceModified ); // for a source touched but not changed
+
+    OutlineSnapshot();
+    ~OutlineSnapshot();
+
+    bool open( const QString & path ); // false when missing, damaged or from another version
+    void close();
+    bool isOpen() const { return fData != nullptr; }
+
+    // of the source the snapshot was written for, the caller decides whether it still matches
+    quint64 sourceHash() const;
+    qint64 sourceSize() const;
+    qint64 sourceModified() const; // msecs since the epoch, -1 when unknown
+
+    void adoptInto( OutlineIndex & index ) const; // valid until close
+    ShownCounts shownCounts() const;
+private:
+    std::unique_ptr< QFile > fFile;
+    const uchar * fData{ nullptr };
+    qint64 fSize{ 0 };
+};
+
+#endif
@@ -0,0 +1,212 @@
+
+#include "rowevictor.h"
+#include "evictablemodel.h"
+
+#include <QAbstractItemView>
+#include <QTreeView>
+#include <QTimer>
+
+#include <limits>
+
+namespace
+{
+    const int kCheckIntervalMS = 1000;
+    const int kDefaultCollapsedAgeMS = 30000;
+    const int kMarginScreens = 40; // twice the deepest ScrollPrefetcher lookahead, so it does not fetch straight back
+}
+
+RowEvictor::RowEvictor( QAbstractItemView * view )
+    : QObject( view ),
+    fView( view ),
+    fCollapsedAgeMS( kDefaultCollapsedAgeMS )
+{
+    fCheckTimer = new QTimer( this );
+    fCheckTimer->setSingleShot( true );
+    fCheckTimer->setInterval( 0 );
+    connect( fCheckTimer, &QTimer::timeout, this, &RowEvictor::check );
+
+    fIntervalTimer = new QTimer( this );
+    fIntervalTimer->setInterval( kCheckIntervalMS );
+    connect( fIntervalTimer, &QTimer::timeout, this, &RowEvictor::check );
+
+    if ( auto tree = qobject_cast< QTreeView * >( fView ) )
+    {
+        connect( tree, &QTreeView::collapsed, this, &RowEvictor::collapsed );
+        connect( tree, &QTreeView::expanded, this, &RowEvictor::expanded );
+    }
+    if ( auto model = fView->model() )
+    {
+        connect( model, &QAbstractItemModel::rowsInserted, fCheckTimer, qOverload<>( &QTimer::start ) );
+        connect( model, &QAbstractItemModel::modelReset, this, &RowEvictor::modelReset );
+    }
+}
+
+void RowEvictor::setMemoryLimit( qint64 bytes )
+{
+    fLimit = qMax< qint64 >( 0, bytes );
+    fStuckAt = -1;
+    if ( fLimit )
+    {
+        fIntervalTimer->start();
+        fCheckTimer->start();
+    }
+    else
+    {
+        fIntervalTimer->stop();
+        fCheckTimer->stop();
+    }
+}
+
+void RowEvictor::setCollapsedAge( int msecs )
+{
+    fCollapsedAgeMS = qMax( 0, msecs );
+}
+
+void RowEvictor::resetCounts()
+{
+    fEvictionCount = 0;
+    fEvictedRows = 0;
+    fReleasedRows = 0;
+}
+
+QString RowEvictor::report() const
+{
+    auto model = evictableModel();
+    return QString( "RowEvictor\n  limit: %1 KB\n  resident: %2 KB\n  evictions: %3\n  evicted rows: %4\n  rows with data released: %5" )
+        .arg( fLimit / 1024 )
+        .arg( model ? ( model->residentBytes() / 1024 ) : 0 )
+        .arg( fEvictionCount )
+        .arg( fEvictedRows )
+        .arg( fReleasedRows );
+}
+
+void RowEvictor::check()
+{
+    auto model = evictableModel();
+    if ( !model || !fLimit )
+        return;
+
+    auto before = model->residentBytes();
+    if ( ( before <= fLimit ) || ( ( fStuckAt >= 0 ) && ( before < fStuckAt + fStuckAt / 8 ) ) )
+        return;
+
+    if ( evictCollapsed( model, true ) || evictTails( model ) || releaseRowData( model ) || evictCollapsed( model, false ) )
+        return;
+    fStuckAt = ( model->residentBytes() >= before ) ? before : -1;
+}
+
+void RowEvictor::collapsed( const QModelIndex & index )
+{
+    expanded( index );
+    if ( !evictableModel() ) // a proxy's index, nothing to evict through it
+        return;
+    fCollapsed.append( { index, QElapsedTimer() } );
+    fCollapsed.last().since.start();
+}
+
+void RowEvictor::expanded( const QModelIndex & index )
+{
+    for ( int ii = 0; ii < fCollapsed.count(); ++ii )
+    {
+        if ( fCollapsed[ ii ].index == index )
+        {
+            fCollapsed.remove( ii );
+            return;
+        }
+    }
+}
+
+void RowEvictor::modelReset()
+{
+    fCollapsed.clear();
+    fStuckAt = -1;
+}
+
+// Returns true once the model is under the limit. Nodes inside an evicted
+// subtree lose their persistent index and are dropped on the way.
+bool RowEvictor::evictCollapsed( EvictableModel * model, bool oldOnly )
+{
+    while ( !fCollapsed.isEmpty() )
+    {
+        if ( !fCollapsed.first().index.isValid() || ( fCollapsed.first().index.model() != fView->model() ) )
+        {
+            fCollapsed.removeFirst();
+            continue;
+        }
+        if ( oldOnly && ( fCollapsed.first().since.elapsed() < fCollapsedAgeMS ) )
+            break;
+
+        QModelIndex index = fCollapsed.takeFirst().index;
+        evict( model, index, 0 );
+        if ( model->residentBytes() <= fLimit )
+            return true;
+    }
+    return false;
+}
+
+// Everything after the row a margin below the viewport is evicted: the
+// siblings after it, and after each of its ancestors. Rows above the viewport
+// stay, what a parent shows is always a prefix of its children.
+bool RowEvictor::evictTails( EvictableModel * model )
+{
+    auto index = fView->indexAt( QPoint( 1, fView->viewport()->rect().bottom() - 1 ) );
+    if ( !index.isValid() )
+        return false; // the rows end inside the viewport
+
+    auto margin = marginRows();
+    auto tree = qobject_cast< QTreeView * >( fView );
+    for ( int ii = 0; ii < margin; ++ii )
+    {
+        auto next = tree ? tree->indexBelow( index ) : index.sibling( index.row() + 1, index.column() );
+        if ( !next.isValid() )
+            return false;
+        index = next;
+    }
+
+    for ( ; index.isValid(); index = index.parent() )
+        evict( model, index.parent(), index.row() + 1 );
+    return model->residentBytes() <= fLimit;
+}
+
+// By the top level rows at the edges of the viewport, the rows stay where they are
+bool RowEvictor::releaseRowData( EvictableModel * model )
+{
+    auto topLevel = []( QModelIndex index )
+    {
+        while ( index.parent().isValid() )
+            index = index.parent();
+        return index;
+    };
+    auto top = topLevel( fView->indexAt( QPoint( 1, 1 ) ) );
+    if ( !top.isValid() )
+        return false;
+    auto bottom = topLevel( fView->indexAt( QPoint( 1, fView->viewport()->rect().bottom() - 1 ) ) );
+
+    auto margin = marginRows();
+    auto last = bottom.isValid() ? ( bottom.row() + margin ) : std::numeric_limits< int >::max();
+    auto rows = model->releaseRowData( qMax( 0, top.row() - margin ), last );
+    if ( rows > 0 )
+        fReleasedRows += rows;
+    return model->residentBytes() <= fLimit;
+}
+
+int RowEvictor::marginRows() const
+{
+    auto rowHeight = qMax( 1, qMax( fView->fontMetrics().height(), fView->sizeHintForRow( 0 ) ) );
+    return kMarginScreens * qMax( 1, fView->viewport()->height() / rowHeight );
+}
+
+void RowEvictor::evict( EvictableModel * model, const QModelIndex & parent, int keepRows )
+{
+    auto rows = model->evictRows( parent, keepRows );
+    if ( rows <= 0 )
+        return;
+    fEvictionCount++;
+    fEvictedRows += rows;
+}
+
+// the view's own model, eviction is not passed through proxies
+EvictableModel * RowEvictor::evictableModel() const
+{
+    return dynamic_cast< EvictableModel * >( fView->model() );
+}
@@ -0,0 +1,84 @@
+
+#ifndef ROWEVICTOR_H
+#define ROWEVICTOR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QPersistentModelIndex>
+#include <QVector>
+
+class QAbstractItemView;
+class QTimer;
+class EvictableModel;
+
+// Gives back what a view's EvictableModel reports as resident once that is over
+// a limit. Over it, until back under, it evicts the children of nodes collapsed
+// for longer than the collapsed age, oldest first, then everything further than
+// a margin past the bottom of the viewport, then the per row data the model
+// keeps for rows further than the margin above or below the viewport, then the
+// children of the remaining collapsed nodes. Evicted rows come back through the
+// usual fetchMore when they are scrolled to or expanded again.
+// The limit bounds what eviction can reach, it is not a ceiling on the model:
+// rows above the viewport are never evicted. A parent shows a prefix of its
+// children and fetchMore only appends, and a view holds an index for every
+// shown row, so rows above it could not be released in place. Scrolling down
+// through a very long outline therefore keeps every item above the viewport,
+// including the children of nodes still expanded far above it; only per row
+// data such as FileListModel's metadata goes there.
+// Checks after rows are inserted and once a second, so create it once the
+// view has its model. A limit of 0, the default, turns it off.
+class RowEvictor : public QObject
+{
+    Q_OBJECT
+
+public:
+    RowEvictor( QAbstractItemView * view );
+
+    void setMemoryLimit( qint64 bytes );
+    qint64 memoryLimit() const { return fLimit; }
+
+    void setCollapsedAge( int msecs );
+    int collapsedAge() const { return fCollapsedAgeMS; }
+
+    int evictionCount() const { return fEvictionCount; }
+    qint64 evictedRows() const { return fEvictedRows; }
+    qint64 releasedRows() const { return fReleasedRows; } // rows whose data went, the rows stayed
+    void resetCounts();
+
+    QString report() const;
+
+public slots:
+    void check();
+
+private:
+    struct Collapsed
+    {
+        QPersistentModelIndex index;
+        QElapsedTimer since;
+    };
+
+    void collapsed( const QModelIndex & index );
+    void expanded( const QModelIndex & index );
+    void modelReset();
+
+    bool evictCollapsed( EvictableModel * model, bool oldOnly );
+    bool evictTails( EvictableModel * model );
+    bool releaseRowData( EvictableModel * model );
+    int marginRows() const;
+    void evict( EvictableModel * model, const QModelIndex & parent, int keepRows );
+    EvictableModel * evictableModel() const;
+
+    QAbstractItemView * fView;
+    QTimer * fCheckTimer;
+    QTimer * fIntervalTimer;
+    qint64 fLimit{ 0 };
+    int fCollapsedAgeMS;
+    qint64 fStuckAt{ -1 }; // resident bytes after a pass that freed nothing, retried once grown by an eighth
+    QVector< Collapsed > fCollapsed; // in the order they were collapsed
+
+    int fEvictionCount{ 0 };
+    qint64 fEvictedRows{ 0 };
+    qint64 fReleasedRows{ 0 };
+};
+
+#endif
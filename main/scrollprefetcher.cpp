@@ -0,0 +1,200 @@
+
+#include "scrollprefetcher.h"
+
+#include <QAbstractItemView>
+#include <QTreeView>
+#include <QScrollBar>
+#include <QTimer>
+
+namespace
+{
+    const int kStopAfterMS = 150; // no scrolling for this long ends prefetching
+    const int kSliceBudgetMS = 4; // fetching per event loop pass
+    const int kMaxLookaheadScreens = 20;
+    const double kVelocitySmoothing = 0.3;
+}
+
+ScrollPrefetcher::ScrollPrefetcher( QAbstractItemView * view )
+    : QObject( view ),
+    fView( view )
+{
+    fSliceTimer = new QTimer( this );
+    fSliceTimer->setSingleShot( true );
+    fSliceTimer->setInterval( 0 );
+    connect( fSliceTimer, &QTimer::timeout, this, &ScrollPrefetcher::prefetchSlice );
+
+    fStopTimer = new QTimer( this );
+    fStopTimer->setSingleShot( true );
+    fStopTimer->setInterval( kStopAfterMS );
+    connect( fStopTimer, &QTimer::timeout, this, &ScrollPrefetcher::stopped );
+
+    fLastValue = fView->verticalScrollBar()->value();
+    connect( fView->verticalScrollBar(), &QScrollBar::valueChanged, this, &ScrollPrefetcher::scrolled );
+}
+
+void ScrollPrefetcher::setEnabled( bool enabled )
+{
+    fEnabled = enabled;
+    if ( !fEnabled )
+        fSliceTimer->stop();
+}
+
+void ScrollPrefetcher::setLookahead( int msecs )
+{
+    fLookaheadMS = qMax( 0, msecs );
+}
+
+void ScrollPrefetcher::resetCounts()
+{
+    fStallCount = 0;
+    fPrefetchCount = 0;
+}
+
+// The speed is smoothed over the scroll events of one gesture, the first
+// event after a pause only gives the direction.
+void ScrollPrefetcher::scrolled( int value )
+{
+    double rows = value - fLastValue;
+    if ( fView->verticalScrollMode() == QAbstractItemView::ScrollPerPixel )
+        rows /= rowHeight();
+    fLastValue = value;
+    if ( rows != 0 )
+        fDown = ( rows > 0 );
+
+    if ( fSinceScroll.isValid() )
+    {
+        auto elapsed = fSinceScroll.restart();
+        if ( elapsed > 0 )
+            fVelocity += kVelocitySmoothing * ( ( rows * 1000.0 / elapsed ) - fVelocity );
+    }
+    else
+        fSinceScroll.start();
+
+    checkStall();
+    if ( fEnabled )
+        fSliceTimer->start();
+    fStopTimer->start();
+}
+
+void ScrollPrefetcher::stopped()
+{
+    fVelocity = 0.0;
+    fSinceScroll.invalidate();
+    fSliceTimer->stop();
+}
+
+// Walks from the viewport edge in the scroll direction; another slice is
+// queued as long as fetching makes progress, so input is handled in between.
+void ScrollPrefetcher::prefetchSlice()
+{
+    if ( !fView->model() )
+        return;
+
+    auto screen = viewportRows();
+    auto lookaheadRows = screen + static_cast< int >( qAbs( fVelocity ) * fLookaheadMS / 1000.0 );
+    lookaheadRows = qMin( lookaheadRows, kMaxLookaheadScreens * screen );
+
+    QElapsedTimer budget;
+    budget.start();
+    bool fetched = false;
+    auto index = edgeIndex( fDown );
+    for ( int ii = 0; index.isValid() && ( ii < lookaheadRows ); ++ii )
+    {
+        if ( fetchAround( index ) )
+        {
+            fetched = true;
+            if ( budget.elapsed() >= kSliceBudgetMS )
+                break;
+        }
+        index = nextIndex( index, fDown );
+    }
+
+    if ( fetched )
+        fSliceTimer->start();
+}
+
+// Fetches for an expanded node about to scroll in and for the parent of a
+// row that is the last one shown, returns true if either grew
+bool ScrollPrefetcher::fetchAround( const QModelIndex & index )
+{
+    auto model = fView->model();
+    bool retVal = false;
+
+    auto tree = qobject_cast< QTreeView * >( fView );
+    if ( tree && tree->isExpanded( index ) && model->canFetchMore( index ) )
+    {
+        auto before = model->rowCount( index );
+        model->fetchMore( index );
+        retVal = model->rowCount( index ) > before;
+    }
+
+    auto parent = index.parent();
+    auto shown = model->rowCount( parent );
+    if ( ( index.row() == shown - 1 ) && model->canFetchMore( parent ) )
+    {
+        model->fetchMore( parent );
+        retVal = ( model->rowCount( parent ) > shown ) || retVal;
+    }
+
+    if ( retVal )
+        fPrefetchCount++;
+    return retVal;
+}
+
+// Only downward scrolling can run out of rows, fetched rows are appended
+void ScrollPrefetcher::checkStall()
+{
+    auto model = fView->model();
+    bool stalled = false;
+    if ( model && fDown )
+    {
+        auto index = edgeIndex( true );
+        if ( index.isValid() )
+        {
+            auto parent = index.parent();
+            stalled = ( index.row() == model->rowCount( parent ) - 1 ) && model->canFetchMore( parent );
+        }
+    }
+
+    if ( stalled && !fStalled )
+        fStallCount++;
+    fStalled = stalled;
+}
+
+int ScrollPrefetcher::rowHeight() const
+{
+    return qMax( 1, qMax( fView->fontMetrics().height(), fView->sizeHintForRow( 0 ) ) );
+}
+
+int ScrollPrefetcher::viewportRows() const
+{
+    return qMax( 1, fView->viewport()->height() / rowHeight() );
+}
+
+// the last row visible in the direction of travel
+QModelIndex ScrollPrefetcher::edgeIndex( bool down ) const
+{
+    auto rect = fView->viewport()->rect();
+    if ( !down )
+        return fView->indexAt( QPoint( 1, 1 ) );
+
+    auto retVal = fView->indexAt( QPoint( 1, rect.bottom() - 1 ) );
+    if ( retVal.isValid() )
+        return retVal;
+
+    // the rows end above the bottom of the viewport
+    retVal = fView->indexAt( QPoint( 1, 1 ) );
+    for ( auto next = nextIndex( retVal, true ); next.isValid(); next = nextIndex( next, true ) )
+        retVal = next;
+    return retVal;
+}
+
+QModelIndex ScrollPrefetcher::nextIndex( const QModelIndex & index, bool down ) const
+{
+    if ( !index.isValid() )
+        return QModelIndex();
+
+    if ( auto tree = qobject_cast< QTreeView * >( fView ) )
+        return down ? tree->indexBelow( index ) : tree->indexAbove( index );
+    return index.sibling( index.row() + ( down ? 1 : -1 ), index.column() );
+}
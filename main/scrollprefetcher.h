@@ -0,0 +1,66 @@
+
+#ifndef SCROLLPREFETCHER_H
+#define SCROLLPREFETCHER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QModelIndex>
+
+class QAbstractItemView;
+class QTimer;
+
+// Fetches ahead of a scrolling view so it rarely reaches the end of what its
+// model has fetched. Scroll speed and direction give a lookahead in rows; the
+// rows that far past the viewport edge are walked in short idle time slices,
+// fetching for parents whose shown children run out and for expanded nodes.
+// Stops shortly after scrolling does.
+// A stall is the viewport edge reaching a parent that can still fetch more,
+// counted whether or not prefetching is enabled so the two can be compared.
+// Create it before any end of list fetch helper on the same view, so stalls
+// are seen before that helper fetches them away.
+class ScrollPrefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    ScrollPrefetcher( QAbstractItemView * view );
+
+    void setEnabled( bool enabled );
+    bool isEnabled() const { return fEnabled; }
+
+    void setLookahead( int msecs ); // how far ahead, in time at the current speed
+    int lookahead() const { return fLookaheadMS; }
+
+    int stallCount() const { return fStallCount; }
+    int prefetchCount() const { return fPrefetchCount; }
+    double velocity() const { return fVelocity; } // rows per second, negative when scrolling up
+    void resetCounts();
+
+private:
+    void scrolled( int value );
+    void stopped();
+    void prefetchSlice();
+    void checkStall();
+    bool fetchAround( const QModelIndex & index );
+
+    int rowHeight() const;
+    int viewportRows() const;
+    QModelIndex edgeIndex( bool down ) const;
+    QModelIndex nextIndex( const QModelIndex & index, bool down ) const;
+
+    QAbstractItemView * fView;
+    QTimer * fSliceTimer;
+    QTimer * fStopTimer;
+    QElapsedTimer fSinceScroll;
+    int fLastValue{ 0 };
+    double fVelocity{ 0.0 };
+    bool fDown{ true };
+    bool fEnabled{ true };
+    int fLookaheadMS{ 500 };
+
+    bool fStalled{ false };
+    int fStallCount{ 0 };
+    int fPrefetchCount{ 0 };
+};
+
+#endif
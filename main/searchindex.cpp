@@ -0,0 +1,223 @@
+
+#include "searchindex.h"
+#include "outlinescanner.h"
+
+#include <QVarLengthArray>
+
+#include <algorithm>
+
+namespace
+{
+    // trigrams are hashed into a fixed number of buckets, collisions only add candidates
+    const int kBucketBits = 16;
+    const int kBucketCount = 1 << kBucketBits;
+    const int kCancelCheckLines = 4096;
+
+    inline uchar fold( char ch )
+    {
+        auto retVal = static_cast< uchar >( ch );
+        return ( retVal >= 'A' && retVal <= 'Z' ) ? ( retVal + ( 'a' - 'A' ) ) : retVal;
+    }
+
+    inline quint16 bucket( const char * text )
+    {
+        quint32 key = fold( text[ 0 ] ) | ( fold( text[ 1 ] ) << 8 ) | ( fold( text[ 2 ] ) << 16 );
+        return static_cast< quint16 >( ( key * 2654435761u ) >> ( 32 - kBucketBits ) );
+    }
+
+    using BucketList = QVarLengthArray< quint16, 256 >;
+
+    // the distinct buckets of the trigrams in every column of the line
+    void lineBuckets( const OutlineScanner & scanner, BucketList & buckets )
+    {
+        buckets.clear();
+        for ( int ii = 0; ii < scanner.columnCount(); ++ii )
+        {
+            auto && column = scanner.column( ii );
+            for ( int pos = 0; pos + 3 <= column.size; ++pos )
+                buckets.append( bucket( column.data + pos ) );
+        }
+        std::sort( buckets.begin(), buckets.end() );
+        buckets.resize( std::unique( buckets.begin(), buckets.end() ) - buckets.begin() );
+    }
+
+    bool containsFolded( const char * haystack, int size, const QByteArray & needle )
+    {
+        auto needleSize = needle.size();
+        for ( int pos = 0; pos + needleSize <= size; ++pos )
+        {
+            int ii = 0;
+            while ( ( ii < needleSize ) && ( fold( haystack[ pos + ii ] ) == static_cast< uchar >( needle[ ii ] ) ) )
+                ++ii;
+            if ( ii == needleSize )
+                return true;
+        }
+        return false;
+    }
+}
+
+// Two passes, the first counts the postings of each bucket so the second can
+// fill a single array without per bucket allocations.
+bool SearchIndex::build( OutlineScanner & scanner, const std::atomic< bool > * cancel )
+{
+    clear();
+    fSource = scanner.data();
+    fSourceSize = scanner.size();
+
+    fBucketStart.fill( 0, kBucketCount + 1 );
+    BucketList buckets;
+
+    // same clamping as TreeModel::setupModelData, at most one level below the previous line
+    QVarLengthArray< int, 32 > openLines;
+    QVarLengthArray< int, 32 > nextRow; // nextRow[ depth ] is the row of the next line at that depth
+    nextRow.append( 0 );
+    while ( scanner.next() )
+    {
+        int line = fOffsets.count();
+        if ( cancel && ( ( line % kCancelCheckLines ) == 0 ) && *cancel )
+        {
+            clear();
+            return false;
+        }
+
+        auto depth = qMin( scanner.depth(), openLines.size() );
+        for ( int ii = depth; ii < openLines.size(); ++ii )
+            fSubtreeEnd[ openLines[ ii ] ] = line;
+        openLines.resize( depth );
+        if ( nextRow.size() <= depth )
+            nextRow.append( 0 );
+        else
+            nextRow.resize( depth + 1 );
+
+        fOffsets.append( scanner.lineOffset() );
+        fParents.append( ( depth == 0 ) ? -1 : openLines.back() );
+        fRows.append( nextRow[ depth ]++ );
+        fSubtreeEnd.append( line + 1 );
+        openLines.append( line );
+
+        lineBuckets( scanner, buckets );
+        for ( auto && curr : buckets )
+            fBucketStart[ curr + 1 ]++;
+    }
+
+    for ( int ii = 0; ii < openLines.size(); ++ii )
+        fSubtreeEnd[ openLines[ ii ] ] = fOffsets.count();
+
+    for ( int ii = 0; ii < kBucketCount; ++ii )
+        fBucketStart[ ii + 1 ] += fBucketStart[ ii ];
+    fPostings.resize( fBucketStart[ kBucketCount ] );
+
+    auto fillPos = fBucketStart;
+    OutlineScanner second( fSource, fSourceSize );
+    for ( int line = 0; second.next(); ++line )
+    {
+        if ( cancel && ( ( line % kCancelCheckLines ) == 0 ) && *cancel )
+        {
+            clear();
+            return false;
+        }
+
+        lineBuckets( second, buckets );
+        for ( auto && curr : buckets )
+            fPostings[ fillPos[ curr ]++ ] = line;
+    }
+    return true;
+}
+
+void SearchIndex::clear()
+{
+    fSource = nullptr;
+    fSourceSize = 0;
+    fOffsets.clear();
+    fParents.clear();
+    fRows.clear();
+    fSubtreeEnd.clear();
+    fBucketStart.clear();
+    fPostings.clear();
+}
+
+qint64 SearchIndex::memoryUsage() const
+{
+    return fOffsets.capacity() * sizeof( qint64 )
+        + ( fParents.capacity() + fRows.capacity() + fSubtreeEnd.capacity() + fBucketStart.capacity() + fPostings.capacity() ) * sizeof( int );
+}
+
+// Candidates come from the shortest posting list of the query's trigrams,
+// each is binary searched in the others before the text is compared.
+// Queries shorter than a trigram compare every line.
+QVector< int > SearchIndex::find( const QString & text, int maxResults ) const
+{
+    QVector< int > retVal;
+    if ( text.isEmpty() || isEmpty() || ( maxResults <= 0 ) )
+        return retVal;
+
+    auto needle = text.toUtf8();
+    for ( auto && ch : needle )
+        ch = static_cast< char >( fold( ch ) );
+
+    if ( needle.size() < 3 )
+    {
+        for ( int line = 0; ( line < lineCount() ) && ( retVal.count() < maxResults ); ++line )
+        {
+            if ( matches( line, needle ) )
+                retVal << line;
+        }
+        return retVal;
+    }
+
+    QVarLengthArray< quint16, 64 > buckets;
+    for ( int pos = 0; pos + 3 <= needle.size(); ++pos )
+        buckets.append( bucket( needle.constData() + pos ) );
+    std::sort( buckets.begin(), buckets.end() );
+    buckets.resize( std::unique( buckets.begin(), buckets.end() ) - buckets.begin() );
+    std::sort( buckets.begin(), buckets.end(), [ this ]( quint16 lhs, quint16 rhs )
+    {
+        return ( fBucketStart[ lhs + 1 ] - fBucketStart[ lhs ] ) < ( fBucketStart[ rhs + 1 ] - fBucketStart[ rhs ] );
+    } );
+
+    auto postings = fPostings.constData();
+    auto shortest = buckets[ 0 ];
+    for ( int ii = fBucketStart[ shortest ]; ( ii < fBucketStart[ shortest + 1 ] ) && ( retVal.count() < maxResults ); ++ii )
+    {
+        auto line = postings[ ii ];
+        bool candidate = true;
+        for ( int jj = 1; candidate && ( jj < buckets.size() ); ++jj )
+            candidate = std::binary_search( postings + fBucketStart[ buckets[ jj ] ], postings + fBucketStart[ buckets[ jj ] + 1 ], line );
+        if ( candidate && matches( line, needle ) )
+            retVal << line;
+    }
+    return retVal;
+}
+
+QVector< int > SearchIndex::path( int line ) const
+{
+    QVector< int > retVal;
+    for ( ; line >= 0; line = fParents[ line ] )
+        retVal.prepend( fRows[ line ] );
+    return retVal;
+}
+
+QString SearchIndex::text( int line, int column ) const
+{
+    auto offset = fOffsets[ line ];
+    OutlineScanner scanner( fSource + offset, fSourceSize - offset );
+    if ( !scanner.next() || ( column < 0 ) || ( column >= scanner.columnCount() ) )
+        return QString();
+    return scanner.column( column ).toString();
+}
+
+bool SearchIndex::matches( int line, const QByteArray & needle ) const
+{
+    auto offset = fOffsets[ line ];
+    OutlineScanner scanner( fSource + offset, fSourceSize - offset );
+    if ( !scanner.next() )
+        return false;
+
+    for ( int ii = 0; ii < scanner.columnCount(); ++ii )
+    {
+        auto && column = scanner.column( ii );
+        if ( containsFolded( column.data, column.size, needle ) )
+            return true;
+    }
+    return false;
+}
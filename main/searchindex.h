@@ -0,0 +1,51 @@
+
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <QVector>
+#include <QString>
+
+#include <atomic>
+
+class OutlineScanner;
+
+// Substring search over every column of an outline, independent of which
+// items have been created. Each line is posted under the hashed trigrams of
+// its columns, a query intersects the lists of its own trigrams and checks
+// the remaining candidates against the text. Case folding is ASCII only.
+class SearchIndex
+{
+public:
+    // returns false when canceled, the index is left empty
+    bool build( OutlineScanner & scanner, const std::atomic< bool > * cancel = nullptr );
+    void clear();
+
+    bool isEmpty() const { return fOffsets.isEmpty(); }
+    int lineCount() const { return fOffsets.count(); }
+    qint64 memoryUsage() const;
+
+    QVector< int > find( const QString & text, int maxResults ) const; // matching lines, in file order
+    QVector< int > path( int line ) const; // rows from the top level down to the line
+
+    // line -1 is the invisible root, the children of a line start right after it
+    int parent( int line ) const { return fParents[ line ]; }
+    int row( int line ) const { return fRows[ line ]; }
+    int subtreeEnd( int line ) const { return ( line < 0 ) ? lineCount() : fSubtreeEnd[ line ]; }
+    QString text( int line, int column ) const;
+private:
+    bool matches( int line, const QByteArray & needle ) const;
+
+    const char * fSource{ nullptr };
+    qint64 fSourceSize{ 0 };
+
+    QVector< qint64 > fOffsets;
+    QVector< int > fParents; // -1 for top level lines
+    QVector< int > fRows;
+    QVector< int > fSubtreeEnd;
+
+    // postings of bucket b are fPostings[ fBucketStart[ b ] .. fBucketStart[ b + 1 ] )
+    QVector< int > fBucketStart;
+    QVector< int > fPostings;
+};
+
+#endif
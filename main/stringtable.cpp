@@ -0,0 +1,100 @@
+
+#include "stringtable.h"
+
+#include <cstring>
+
+namespace
+{
+    // a column is judged after this many values, and dropped below the hit rate
+    const qint64 kColumnSample = 1024;
+    const double kMinColumnHitRate = 0.5;
+
+    qint64 stringBytes( const QString & string )
+    {
+        return sizeof( QString ) + sizeof( QString::Data ) + ( string.size() + 1 ) * sizeof( QChar );
+    }
+}
+
+bool StringTable::Key::operator==( const Key & rhs ) const
+{
+    return ( size == rhs.size ) && ( std::memcmp( data, rhs.data, size ) == 0 );
+}
+
+uint qHash( const StringTable::Key & key, uint seed )
+{
+    return qHashBits( key.data, key.size, seed );
+}
+
+int StringTable::intern( int column, const char * data, int size )
+{
+    if ( column >= fColumns.count() )
+        fColumns.resize( column + 1 );
+    auto && state = fColumns[ column ];
+    if ( !state.enabled )
+        return -1;
+
+    state.lookups++;
+    fStats.lookups++;
+
+    int id = -1;
+    auto pos = fLookup.find( { data, size } );
+    if ( pos != fLookup.end() )
+    {
+        id = pos.value();
+        state.hits++;
+        fStats.hits++;
+    }
+    else
+    {
+        id = fStrings.count();
+        fStrings.append( QString::fromUtf8( data, size ) );
+        fStringBytes += stringBytes( fStrings.last() );
+        fLookup.insert( { data, size }, id );
+        fStats.strings = fStrings.count();
+    }
+
+    if ( ( state.lookups == kColumnSample ) && ( double( state.hits ) / state.lookups < kMinColumnHitRate ) )
+        state.enabled = false;
+    return id;
+}
+
+// the counters come from the worker's table, the pool bytes are the strings adopted here
+void StringTable::adopt( const QVector< QString > & strings, const Stats & stats )
+{
+    fStrings += strings;
+    for ( auto && string : strings )
+        fStringBytes += stringBytes( string );
+    fStats.lookups = stats.lookups;
+    fStats.hits = stats.hits;
+    fStats.strings = fStrings.count();
+}
+
+int StringTable::merge( const StringTable & other )
+{
+    auto retVal = fStrings.count();
+    fStrings += other.fStrings;
+    fStats.lookups += other.fStats.lookups;
+    fStats.hits += other.fStats.hits;
+    fStats.strings = fStrings.count();
+    fStringBytes += other.fStringBytes;
+    return retVal;
+}
+
+// a lookup entry is a hash node holding the key and id, next to its bucket
+StringTable::Stats StringTable::stats() const
+{
+    auto retVal = fStats;
+    retVal.poolBytes = fStringBytes + fLookup.size() * qint64( sizeof( Key ) + sizeof( int ) + 2 * sizeof( void * ) ) + fLookup.capacity() * qint64( sizeof( void * ) );
+    retVal.decodesAvoided = fReads;
+    return retVal;
+}
+
+void StringTable::clear()
+{
+    fLookup.clear();
+    fStrings.clear();
+    fColumns.clear();
+    fStats = Stats();
+    fStringBytes = 0;
+    fReads = 0;
+}
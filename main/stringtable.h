@@ -0,0 +1,67 @@
+
+#ifndef STRINGTABLE_H
+#define STRINGTABLE_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+// Interns cell values so identical text shares one decoded, immutable QString.
+// Interning is decided per column: a column whose values rarely repeat (titles)
+// stops being interned after a sample and its cells stay plain source offsets.
+// Lookup keys point into the model's source text, which outlives the table.
+// A cell is 8 bytes either way, so interning spends memory on the pool to save
+// decoding the source on every read; the stats report both sides.
+class StringTable
+{
+public:
+    struct Stats
+    {
+        double hitRate() const { return lookups ? double( hits ) / lookups : 0.0; }
+
+        qint64 lookups{ 0 };
+        qint64 hits{ 0 };
+        qint64 poolBytes{ 0 }; // the decoded strings and their lookup entries, a plain offset cell holds neither
+        qint64 decodesAvoided{ 0 }; // reads answered from the pool instead of decoding the source
+        int strings{ 0 };
+    };
+
+    // returns -1 when the column is not interned
+    int intern( int column, const char * data, int size );
+    const QString & string( int id ) const { fReads++; return fStrings[ id ]; }
+    int count() const { return fStrings.count(); }
+
+    // hands strings interned on a worker over to the table the GUI reads from
+    QVector< QString > stringsFrom( int first ) const { return fStrings.mid( first ); }
+    void adopt( const QVector< QString > & strings, const Stats & stats );
+    // appends the strings of a table filled independently, its ids are then offset by the
+    // returned count; they are not looked up by later interning
+    int merge( const StringTable & other );
+
+    Stats stats() const;
+    void clear();
+private:
+    struct Key
+    {
+        const char * data;
+        int size;
+        bool operator==( const Key & rhs ) const;
+    };
+    friend uint qHash( const Key & key, uint seed );
+
+    struct ColumnState
+    {
+        qint64 lookups{ 0 };
+        qint64 hits{ 0 };
+        bool enabled{ true };
+    };
+
+    QHash< Key, int > fLookup;
+    QVector< QString > fStrings;
+    QVector< ColumnState > fColumns;
+    Stats fStats; // the counters, pool bytes and reads are filled in by stats()
+    qint64 fStringBytes{ 0 };
+    mutable qint64 fReads{ 0 };
+};
+
+#endif
@@ -0,0 +1,261 @@
+
+#include "treefiltermodel.h"
+#include "treemodel.h"
+#include "searchindex.h"
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+TreeFilterModel::TreeFilterModel( QObject * parent )
+    : QAbstractItemModel( parent )
+{
+    fCollator.setNumericMode( true );
+    fCollator.setCaseSensitivity( Qt::CaseInsensitive );
+    fNodes.append( Node() );
+}
+
+void TreeFilterModel::setSourceModel( TreeModel * model )
+{
+    if ( fSource )
+        disconnect( fSource, nullptr, this, nullptr );
+
+    fSource = model;
+    if ( fSource )
+    {
+        connect( fSource, &TreeModel::modelReset, this, &TreeFilterModel::sourceReset );
+        connect( fSource, &TreeModel::reloaded, this, &TreeFilterModel::sourceReset );
+        connect( fSource, &TreeModel::searchIndexReady, this, [ this ]()
+        {
+            fReady = true;
+            rebuild();
+        } );
+    }
+    sourceReset();
+}
+
+void TreeFilterModel::setFilterText( const QString & text )
+{
+    if ( text == fFilterText )
+        return;
+
+    fFilterText = text;
+    rebuild();
+}
+
+void TreeFilterModel::sort( int column, Qt::SortOrder order )
+{
+    fSortColumn = column;
+    fSortOrder = order;
+    rebuild();
+}
+
+// the source's index goes with its items, stay empty until the new one is built
+void TreeFilterModel::sourceReset()
+{
+    fReady = fSource && fSource->isSearchIndexReady();
+    rebuild();
+    if ( fSource && !fReady )
+        fSource->buildSearchIndex();
+}
+
+// Only the set of included lines is computed here, the nodes are built as the view walks down
+void TreeFilterModel::rebuild()
+{
+    beginResetModel();
+    fNodes.clear();
+    fNodes.append( Node() );
+    fIncluded.clear();
+    fFetchPolicy.reset();
+
+    if ( fReady && !fFilterText.isEmpty() )
+    {
+        auto && index = fSource->searchIndex();
+        fIncluded.resize( index.lineCount() );
+        for ( auto line : index.find( fFilterText, std::numeric_limits< int >::max() ) )
+        {
+            for ( ; ( line >= 0 ) && !fIncluded.testBit( line ); line = index.parent( line ) )
+                fIncluded.setBit( line );
+        }
+    }
+    endResetModel();
+}
+
+// Included children are reached sibling to sibling, an excluded subtree is skipped in one step
+void TreeFilterModel::buildChildren( int id ) const
+{
+    if ( !fReady || fNodes[ id ].childrenBuilt )
+        return;
+
+    auto && index = fSource->searchIndex();
+    auto line = fNodes[ id ].line;
+    QVector< int > lines;
+    for ( int child = line + 1; child < index.subtreeEnd( line ); child = index.subtreeEnd( child ) )
+    {
+        if ( fIncluded.isEmpty() || fIncluded.testBit( child ) )
+            lines << child;
+    }
+
+    if ( fSortColumn >= 0 )
+    {
+        std::vector< QCollatorSortKey > keys;
+        keys.reserve( lines.count() );
+        for ( auto && child : lines )
+            keys.push_back( fCollator.sortKey( index.text( child, fSortColumn ) ) );
+
+        std::vector< int > order( lines.count() );
+        std::iota( order.begin(), order.end(), 0 );
+        std::stable_sort( order.begin(), order.end(), [ & ]( int lhs, int rhs )
+        {
+            auto cmp = keys[ lhs ].compare( keys[ rhs ] );
+            return ( fSortOrder == Qt::AscendingOrder ) ? ( cmp < 0 ) : ( cmp > 0 );
+        } );
+
+        QVector< int > sorted;
+        sorted.reserve( lines.count() );
+        for ( auto && ii : order )
+            sorted << lines[ ii ];
+        lines = sorted;
+    }
+
+    QVector< int > children;
+    children.reserve( lines.count() );
+    for ( int ii = 0; ii < lines.count(); ++ii )
+    {
+        Node child;
+        child.line = lines[ ii ];
+        child.parent = id;
+        child.row = ii;
+        children << fNodes.count();
+        fNodes.append( child );
+    }
+    fNodes[ id ].children = children;
+    fNodes[ id ].childrenBuilt = true;
+}
+
+// Only walks rows the source already shows, so mapping never inserts rows into it
+QModelIndex TreeFilterModel::mapToSource( const QModelIndex & index ) const
+{
+    if ( !index.isValid() || !fReady )
+        return QModelIndex();
+
+    QModelIndex retVal;
+    for ( auto && row : fSource->searchIndex().path( fNodes[ nodeId( index ) ].line ) )
+    {
+        retVal = fSource->index( row, 0, retVal );
+        if ( !retVal.isValid() )
+            return QModelIndex();
+    }
+    if ( index.column() != 0 )
+        retVal = retVal.sibling( retVal.row(), index.column() );
+    return retVal;
+}
+
+QModelIndex TreeFilterModel::revealInSource( const QModelIndex & index )
+{
+    if ( !index.isValid() || !fReady )
+        return QModelIndex();
+
+    fSource->reveal( fSource->searchIndex().path( fNodes[ nodeId( index ) ].line ) );
+    return mapToSource( index );
+}
+
+QVariant TreeFilterModel::data( const QModelIndex & index, int role ) const
+{
+    if ( !index.isValid() || ( role != Qt::DisplayRole ) )
+        return QVariant();
+
+    return fSource->lineData( fNodes[ nodeId( index ) ].line, index.column() );
+}
+
+Qt::ItemFlags TreeFilterModel::flags( const QModelIndex & index ) const
+{
+    if ( !index.isValid() )
+        return QAbstractItemModel::flags( index );
+
+    return Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+}
+
+QVariant TreeFilterModel::headerData( int section, Qt::Orientation orientation, int role ) const
+{
+    if ( !fSource )
+        return QVariant();
+    return fSource->headerData( section, orientation, role );
+}
+
+QModelIndex TreeFilterModel::index( int row, int column, const QModelIndex & parent ) const
+{
+    if ( !hasIndex( row, column, parent ) )
+        return QModelIndex();
+
+    auto && node = fNodes[ nodeId( parent ) ];
+    return createIndex( row, column, static_cast< quintptr >( node.children[ row ] ) );
+}
+
+QModelIndex TreeFilterModel::parent( const QModelIndex & index ) const
+{
+    if ( !index.isValid() )
+        return QModelIndex();
+
+    auto parentId = fNodes[ nodeId( index ) ].parent;
+    if ( parentId <= 0 )
+        return QModelIndex();
+
+    return createIndex( fNodes[ parentId ].row, 0, static_cast< quintptr >( parentId ) );
+}
+
+int TreeFilterModel::rowCount( const QModelIndex & parent ) const
+{
+    if ( parent.column() > 0 )
+        return 0;
+
+    return fNodes[ nodeId( parent ) ].shown;
+}
+
+int TreeFilterModel::columnCount( const QModelIndex & /*parent*/ ) const
+{
+    return fSource ? fSource->columnCount() : 0;
+}
+
+bool TreeFilterModel::hasChildren( const QModelIndex & parent ) const
+{
+    if ( parent.column() > 0 )
+        return false;
+
+    auto id = nodeId( parent );
+    buildChildren( id );
+    return !fNodes[ id ].children.isEmpty();
+}
+
+bool TreeFilterModel::canFetchMore( const QModelIndex & parent ) const
+{
+    if ( parent.column() > 0 )
+        return false;
+
+    auto id = nodeId( parent );
+    buildChildren( id );
+    return fNodes[ id ].shown < fNodes[ id ].children.count();
+}
+
+void TreeFilterModel::fetchMore( const QModelIndex & parent )
+{
+    if ( !canFetchMore( parent ) )
+        return;
+
+    auto id = nodeId( parent );
+    int currCount = fNodes[ id ].shown;
+    int remainder = fNodes[ id ].children.count() - currCount;
+    int itemsToFetch = fFetchPolicy.batchSize( static_cast< quintptr >( id ), remainder );
+    if ( itemsToFetch <= 0 )
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+    beginInsertRows( parent, currCount, currCount + itemsToFetch - 1 );
+    fNodes[ id ].shown = currCount + itemsToFetch;
+    endInsertRows();
+    fFetchPolicy.batchFetched( itemsToFetch, timer.nsecsElapsed() );
+}
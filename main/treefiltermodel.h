@@ -0,0 +1,77 @@
+
+#ifndef TREEFILTERMODEL_H
+#define TREEFILTERMODEL_H
+
+#include <QAbstractItemModel>
+#include <QBitArray>
+#include <QCollator>
+#include <QVector>
+
+#include "fetchpolicy.h"
+
+class TreeModel;
+
+// Filters and sorts a TreeModel from its search index instead of its items, so
+// lines that were never fetched take part without being created. A filter keeps
+// the matching lines and their ancestors. The children of a node are collected
+// and sorted the first time the node is asked about, on keys computed once per
+// child, then shown in fetchMore batches like the source's.
+class TreeFilterModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+public:
+    TreeFilterModel( QObject * parent = nullptr );
+
+    void setSourceModel( TreeModel * model );
+    TreeModel * sourceModel() const { return fSource; }
+
+    void setFilterText( const QString & text ); // case insensitive, any column, empty keeps every line
+    QString filterText() const { return fFilterText; }
+    virtual void sort( int column, Qt::SortOrder order = Qt::AscendingOrder ) override; // column -1 keeps file order
+
+    QModelIndex mapToSource( const QModelIndex & index ) const; // invalid while the source does not show the row yet
+    QModelIndex revealInSource( const QModelIndex & index ); // fetches the source rows on the path, then maps
+    FetchPolicy & fetchPolicy() { return fFetchPolicy; }
+
+    virtual QVariant data( const QModelIndex & index, int role ) const override;
+    virtual Qt::ItemFlags flags( const QModelIndex & index ) const override;
+    virtual QVariant headerData( int section, Qt::Orientation orientation, int role = Qt::DisplayRole ) const override;
+    virtual QModelIndex index( int row, int column, const QModelIndex & parent = QModelIndex() ) const override;
+    virtual QModelIndex parent( const QModelIndex & index ) const override;
+    virtual int rowCount( const QModelIndex & parent = QModelIndex() ) const override;
+    virtual int columnCount( const QModelIndex & parent = QModelIndex() ) const override;
+    virtual bool hasChildren( const QModelIndex & parent ) const override;
+
+    virtual bool canFetchMore( const QModelIndex & parent ) const override;
+    virtual void fetchMore( const QModelIndex & parent ) override;
+
+private:
+    struct Node
+    {
+        int line{ -1 }; // in the search index, -1 for the root
+        int parent{ -1 };
+        int row{ 0 };
+        int shown{ 0 };
+        bool childrenBuilt{ false };
+        QVector< int > children;
+    };
+
+    void rebuild();
+    void sourceReset();
+    void buildChildren( int id ) const;
+    int nodeId( const QModelIndex & index ) const { return index.isValid() ? static_cast< int >( index.internalId() ) : 0; }
+
+    TreeModel * fSource{ nullptr };
+    QString fFilterText;
+    int fSortColumn{ -1 };
+    Qt::SortOrder fSortOrder{ Qt::AscendingOrder };
+    QCollator fCollator;
+
+    QBitArray fIncluded; // by line, empty when nothing is filtered
+    bool fReady{ false }; // the source's search index is built
+    mutable QVector< Node > fNodes; // 0 is the root, addressed by the internal id of an index
+    FetchPolicy fFetchPolicy;
+};
+
+#endif
@@ -1,43 +1,178 @@
-#include <QStringList>
-#include <stdio.h>
+#include <QString>
+#include <cstring>
+#include <type_traits>
 #include "treeitem.h"
+#include "arena.h"
+#include "stringtable.h"
 
-TreeItem::TreeItem(const QList<QString> &data, TreeItem *parent)
+static_assert( std::is_trivially_destructible< TreeItem >::value, "TreeItems are released with their arena, without destructors" );
+
+TreeItem * TreeItem::create( Arena & arena, StringTable & strings, const char * source, const OutlineScanner & line, TreeItem * parent, int lineIndex )
+{
+    auto count = line.columnCount();
+    auto memory = arena.allocate( sizeof( TreeItem ) + count * sizeof( Column ), alignof( TreeItem ) );
+    auto item = new ( memory ) TreeItem( parent, lineIndex );
+
+    item->itemDataCount = count;
+    if ( count )
+        item->textOffset = line.column( 0 ).data - source;
+    auto lineText = source + item->textOffset;
+    for ( int ii = 0; ii < count; ++ii )
+    {
+        auto && column = line.column( ii );
+        auto id = strings.intern( ii, column.data, column.size );
+        if ( id >= 0 )
+            new ( item->columns() + ii ) Column{ static_cast< quint32 >( id ), Column::kInterned };
+        else
+            new ( item->columns() + ii ) Column{ static_cast< quint32 >( column.data - lineText ), static_cast< quint32 >( column.size ) };
+    }
+    return item;
+}
+TreeItem * TreeItem::createRoot( Arena & arena )
+{
+    return new ( arena.allocate< TreeItem >() ) TreeItem( nullptr, -1 );
+}
+TreeItem * TreeItem::copy( Arena & arena, const TreeItem * other, TreeItem * parent )
+{
+    auto memory = arena.allocate( sizeof( TreeItem ) + other->itemDataCount * sizeof( Column ), alignof( TreeItem ) );
+    auto item = new ( memory ) TreeItem( parent, -1 );
+    item->itemDataCount = other->itemDataCount;
+    item->assignData( other );
+    return item;
+}
+TreeItem::TreeItem( TreeItem * parent, int lineIndex )
 {
     parentItem = parent;
-    for ( auto && jj : data )
-        itemData << jj;
+    outlineLine = lineIndex;
+}
+
+// grows geometrically, the outgrown array goes back to the arena for reuse
+void TreeItem::reserveChildren( Arena & arena, int count )
+{
+    if ( count <= childCapacity )
+        return;
+
+    auto capacity = qMax( count, qMax( 4, childCapacity * 2 ) );
+    auto items = arena.allocate< TreeItem * >( capacity );
+    if ( childItemCount )
+        std::memcpy( items, childItems, childItemCount * sizeof( TreeItem * ) );
+    arena.release( childItems, childCapacity * sizeof( TreeItem * ) );
+    childItems = items;
+    childCapacity = capacity;
+}
+
+void TreeItem::appendChild( Arena & arena, TreeItem * item )
+{
+    reserveChildren( arena, childItemCount + 1 );
+    item->rowInParent = childItemCount;
+    childItems[ childItemCount++ ] = item;
+}
+
+void TreeItem::insertChildren( Arena & arena, int row, TreeItem * const * items, int count )
+{
+    reserveChildren( arena, childItemCount + count );
+    std::memmove( childItems + row + count, childItems + row, ( childItemCount - row ) * sizeof( TreeItem * ) );
+    std::memcpy( childItems + row, items, count * sizeof( TreeItem * ) );
+    childItemCount += count;
+    renumberChildren( row );
+}
+
+void TreeItem::removeChildren( Arena & arena, int row, int count )
+{
+    for ( int ii = row; ii < row + count; ++ii )
+        childItems[ ii ]->release( arena );
+    std::memmove( childItems + row, childItems + row + count, ( childItemCount - row - count ) * sizeof( TreeItem * ) );
+    childItemCount -= count;
+    renumberChildren( row );
 }
-TreeItem::~TreeItem()
+
+void TreeItem::adoptChildren( Arena & arena, TreeItem * other )
 {
-    qDeleteAll(childItems);
+    reserveChildren( arena, childItemCount + other->childItemCount );
+    for ( int ii = 0; ii < other->childItemCount; ++ii )
+    {
+        auto child = other->childItems[ ii ];
+        child->parentItem = this;
+        child->rowInParent = childItemCount;
+        childItems[ childItemCount++ ] = child;
+    }
+    other->childItemCount = 0;
 }
-void TreeItem::addSuffix( int cnt )
+
+void TreeItem::releaseChildren( Arena & arena, int from )
 {
-    auto string = itemData[ 0 ].toString();
-    string += ": " + QString::number( cnt );
-    itemData[ 0 ] = string;
+    for ( int ii = from; ii < childItemCount; ++ii )
+        childItems[ ii ]->release( arena );
+    childItemCount = qMin( childItemCount, from );
+    if ( childItemCount )
+        return;
+
+    arena.release( childItems, childCapacity * sizeof( TreeItem * ) );
+    childItems = nullptr;
+    childCapacity = 0;
 }
 
-void TreeItem::appendChild(TreeItem *item)
+void TreeItem::release( Arena & arena )
 {
-    childItems.append(item);
+    releaseChildren( arena, 0 );
+    arena.release( this, sizeof( TreeItem ) + itemDataCount * sizeof( Column ) );
+}
+
+void TreeItem::renumberChildren( int from )
+{
+    for ( int ii = from; ii < childItemCount; ++ii )
+        childItems[ ii ]->rowInParent = ii;
 }
 TreeItem *TreeItem::child(int row)
 {
-    return childItems.value(row);
+    if ( ( row < 0 ) || ( row >= childItemCount ) )
+        return nullptr;
+    return childItems[ row ];
 }
 int TreeItem::childCount() const
 {
-    return childItems.count();
+    return childItemCount;
 }
 int TreeItem::columnCount() const
 {
-    return itemData.count();
+    return itemDataCount;
+}
+// top level items are numbered by their row
+QVariant TreeItem::data( int column, const char * source, const StringTable & strings ) const
+{
+    if ( ( column < 0 ) || ( column >= itemDataCount ) )
+        return QVariant();
+
+    auto retVal = text( column, source, strings );
+    if ( ( column == 0 ) && isTopLevel() )
+        retVal += ": " + QString::number( rowInParent );
+    return retVal;
+}
+QString TreeItem::text( int column, const char * source, const StringTable & strings ) const
+{
+    if ( ( column < 0 ) || ( column >= itemDataCount ) )
+        return QString();
+
+    auto && col = columns()[ column ];
+    if ( col.size == Column::kInterned )
+        return strings.string( col.offset );
+    return QString::fromUtf8( source + textOffset + col.offset, col.size );
 }
-QVariant TreeItem::data(int column) const
+void TreeItem::assignData( const TreeItem * other )
 {
-    return itemData.value(column);
+    Q_ASSERT( other->itemDataCount == itemDataCount );
+    textOffset = other->textOffset;
+    outlineLine = other->outlineLine;
+    if ( itemDataCount )
+        std::memcpy( columns(), other->columns(), itemDataCount * sizeof( Column ) );
+}
+void TreeItem::rebaseStrings( int base )
+{
+    for ( int ii = 0; ii < itemDataCount; ++ii )
+    {
+        if ( columns()[ ii ].size == Column::kInterned )
+            columns()[ ii ].offset += base;
+    }
 }
 TreeItem *TreeItem::parent()
 {
@@ -45,11 +180,6 @@ TreeItem *TreeItem::parent()
 }
 int TreeItem::row() const
 {
-    if (parentItem)
-    {
-        return parentItem->childItems.indexOf(const_cast<TreeItem*>(this));
-    }
-
-    return 0;
+    return rowInParent;
 }
 //! [8]
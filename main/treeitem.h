@@ -1,30 +1,70 @@
 #ifndef TREEITEM_H
 #define TREEITEM_H
 
-#include <QList>
 #include <QVariant>
 
+#include "outlinescanner.h"
+
+class Arena;
+class StringTable;
+
 //! [0]
+// Items, their child lists and their columns all live in the model's Arena,
+// an item is never deleted on its own, the arena is cleared with the tree.
+// The column table is packed behind the item in the same allocation and only
+// holds offsets into the model's source text or ids in its StringTable, so an
+// item has no pointers into the source and needs no heap block of its own.
 class TreeItem
 {
 public:
-    TreeItem(const QList<QString> &data, TreeItem *parent = 0);
-    ~TreeItem();
+    static TreeItem * create( Arena & arena, StringTable & strings, const char * source, const OutlineScanner & line, TreeItem * parent, int lineIndex = -1 );
+    static TreeItem * createRoot( Arena & arena );
+    static TreeItem * copy( Arena & arena, const TreeItem * other, TreeItem * parent ); // without children, with its line
 
-    void appendChild(TreeItem *child);
+    void appendChild( Arena & arena, TreeItem * child );
+    void insertChildren( Arena & arena, int row, TreeItem * const * items, int count );
+    void removeChildren( Arena & arena, int row, int count ); // gives them and their subtrees back to the arena
+    void adoptChildren( Arena & arena, TreeItem * other ); // appends every child of other
+    void releaseChildren( Arena & arena, int from ); // gives the children from row on and their subtrees back to the arena
+    void reserveChildren( Arena & arena, int count );
 
     TreeItem *child(int row);
     int childCount() const;
+    int shownChildCount() const { return shownCount; }
+    void setShownChildCount( int count ) { shownCount = count; }
     int columnCount() const;
-    QVariant data(int column) const;
+    QVariant data( int column, const char * source, const StringTable & strings ) const;
+    QString text( int column, const char * source, const StringTable & strings ) const; // data without the row number
+    void assignData( const TreeItem * other ); // same column count, the text and line are then other's
+    void rebaseStrings( int base ); // after the StringTable it interned into was merged at base
     int row() const;
+    int lineIndex() const { return outlineLine; }
     TreeItem *parent();
-
-    void addSuffix( int suffix );
+    bool isTopLevel() const { return parentItem && !parentItem->parentItem; }
 private:
-    QList<TreeItem*> childItems;
-    QList<QVariant> itemData;
+    struct Column
+    {
+        static const quint32 kInterned = 0xFFFFFFFF; // size marker, offset is then the string id
+
+        quint32 offset; // from textOffset
+        quint32 size;
+    };
+
+    TreeItem( TreeItem * parent, int lineIndex );
+    void renumberChildren( int from );
+    void release( Arena & arena );
+    const Column * columns() const { return reinterpret_cast< const Column * >( this + 1 ); }
+    Column * columns() { return reinterpret_cast< Column * >( this + 1 ); }
+
     TreeItem *parentItem;
+    TreeItem ** childItems{ nullptr };
+    qint64 textOffset{ 0 }; // start of the first column in the model's source
+    int childItemCount{ 0 };
+    int childCapacity{ 0 };
+    int rowInParent{ 0 }; // position in parentItem->childItems, kept current by append/insert/take
+    int shownCount{ 0 }; // number of children revealed to the view through fetchMore
+    int outlineLine{ -1 }; // line in the model's OutlineIndex when loaded lazily
+    int itemDataCount{ 0 };
 };
 //! [0]
 
@@ -1,26 +1,972 @@
 
 #include <QMenu>
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QtConcurrent>
+#include <QThread>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <cstring>
 
 #include "treeitem.h"
 #include "treemodel.h"
+#include "outlinescanner.h"
+
+namespace
+{
+    const char * const kHeaders[] = { "Title", "Summary" };
+    const int kHeaderCount = sizeof( kHeaders ) / sizeof( kHeaders[ 0 ] );
+
+    // a worker hands finished top level subtrees over when either limit is hit
+    const int kPublishBatchSize = 256;
+    const qint64 kPublishIntervalMS = 50;
+
+    // eParallel splits into a few chunks per core so uneven subtrees even out,
+    // but not below a size where the threads cost more than they save
+    const int kChunksPerThread = 4;
+    const qint64 kMinChunkBytes = 256 * 1024;
+
+    // Offsets of lines that start a top level subtree, about evenly spaced, from 0
+    // to size. A line starting with a tab continues the subtree before it, and so
+    // does one after an empty line, which the scanner skips.
+    QVector< qint64 > topLevelBoundaries( const char * source, qint64 size, int count )
+    {
+        QVector< qint64 > retVal;
+        retVal << 0;
+        for ( int ii = 1; ii < count; ++ii )
+        {
+            auto pos = qMax( retVal.back() + 1, size * ii / count );
+            auto from = pos - 1;
+            while ( true )
+            {
+                auto newline = static_cast< const char * >( std::memchr( source + from, '\n', size - from ) );
+                pos = newline ? ( newline - source + 1 ) : size;
+                if ( ( pos >= size ) || ( ( source[ pos ] != '\t' ) && ( source[ pos ] != '\n' ) ) )
+                    break;
+                from = pos;
+            }
+            if ( pos >= size )
+                break;
+            retVal << pos;
+        }
+        retVal << size;
+        return retVal;
+    }
+
+    // Creates the children of a lazily loaded item from an index of source until it
+    // has count of them, its lines are numbered in the index
+    void materialize( const OutlineIndex & index, const char * source, qint64 sourceSize, Arena & arena, StringTable & strings, TreeItem * item, int count )
+    {
+        int line = -1;
+        if ( item->childCount() == 0 )
+        {
+            item->reserveChildren( arena, index.childCount( item->lineIndex() ) );
+            line = index.firstChild( item->lineIndex() );
+        }
+        else
+            line = index.nextSibling( item->child( item->childCount() - 1 )->lineIndex() );
+
+        while ( item->childCount() < count )
+        {
+            auto offset = index.offset( line );
+            OutlineScanner scanner( source + offset, sourceSize - offset );
+            scanner.next();
+
+            auto child = TreeItem::create( arena, strings, source, scanner, item, line );
+            item->appendChild( arena, child );
+            line = index.nextSibling( line );
+        }
+    }
+
+    // resources have no time, their snapshots are matched by hash
+    qint64 sourceModified( const QString & path )
+    {
+        auto modified = QFileInfo( path ).lastModified();
+        return modified.isValid() ? modified.toMSecsSinceEpoch() : -1;
+    }
+}
 
 TreeModel::TreeModel( QObject * parent )
     : QAbstractItemModel( parent ),
     rootItem( nullptr )
 {
 }
-void TreeModel::load( const QString & data )
+void TreeModel::load( const QByteArray & data, ELoadMode mode )
+{
+    resetModelData();
+    setSource( data );
+    parseSource( mode );
+}
+
+// The file is mapped read only and parsed in place, node text points into the
+// mapping and is only decoded when data() asks for it.
+// Files that cannot be mapped (compressed resources) are read into memory.
+// With a snapshot directory set, a snapshot matching the source replaces the
+// parse whatever the mode, the tree is then loaded lazily from its index.
+bool TreeModel::loadFile( const QString & path, ELoadMode mode )
+{
+    auto file = std::make_unique< QFile >( path );
+    if ( !file->open( QIODevice::ReadOnly ) )
+        return false;
+
+    resetModelData();
+    auto size = file->size();
+    auto mapped = ( size > 0 ) ? file->map( 0, size ) : nullptr;
+    if ( mapped )
+    {
+        fSourceFile = std::move( file );
+        fSource = reinterpret_cast< const char * >( mapped );
+        fSourceSize = size;
+    }
+    else
+        setSource( file->readAll() );
+
+    if ( !fSnapshotDir.isEmpty() )
+    {
+        fSnapshotPath = snapshotPath( path );
+        fSourceModified = sourceModified( path );
+        if ( fSnapshot.open( fSnapshotPath ) && snapshotMatches() )
+        {
+            loadSnapshot();
+            return true;
+        }
+        fSnapshot.close();
+    }
+
+    parseSource( mode );
+    if ( !fSnapshotPath.isEmpty() )
+        writeSnapshot();
+    return true;
+}
+
+// one file per source path, the source size, time and hash in it decide whether it is still valid
+QString TreeModel::snapshotPath( const QString & sourcePath ) const
+{
+    auto key = QFileInfo( sourcePath ).absoluteFilePath();
+    auto hash = OutlineSnapshot::hashSource( reinterpret_cast< const char * >( key.constData() ), key.size() * sizeof( QChar ) );
+    return QDir( fSnapshotDir ).filePath( QString( "%1.outline" ).arg( hash, 16, 16, QChar( '0' ) ) );
+}
+
+// The size and time in the header settle it without reading the source, only a
+// source of the same size touched since is hashed. When the text is unchanged the
+// new time is recorded so the next open does not hash it again.
+bool TreeModel::snapshotMatches()
 {
-    QList<QString> rootData;
-    rootData << "Title" << "Summary";
-    rootItem = new TreeItem( rootData );
-    auto parentStack = QList< TreeItem * >() << rootItem;
-    setupModelData( data.split( QString( "\n" ) ), parentStack );
+    if ( fSnapshot.sourceSize() != fSourceSize )
+        return false;
+    if ( ( fSourceModified != -1 ) && ( fSnapshot.sourceModified() == fSourceModified ) )
+        return true;
+    if ( OutlineSnapshot::hashSource( fSource, fSourceSize ) != fSnapshot.sourceHash() )
+        return false;
+    if ( fSourceModified != -1 )
+        OutlineSnapshot::writeSourceModified( fSnapshotPath, fSourceModified );
+    return true;
 }
+
+// finishes the reset begun by resetModelData, nothing of the source is read
+// until its items are created
+void TreeModel::loadSnapshot()
+{
+    fLoadTimer.start();
+    fSnapshot.adoptInto( fIndex );
+    fLazy = true;
+    fFromSnapshot = true;
+    restoreShownCounts( fSnapshot.shownCounts() );
+    fStats.loaded( fLoadTimer.nsecsElapsed() );
+    endResetModel();
+}
+
+// On a worker with the hash, the other modes have no index so it is built there
+// by a second scan and kept in fLineIndex to number their lines. Resets wait for
+// it since it reads the source.
+void TreeModel::writeSnapshot()
+{
+    auto path = fSnapshotPath;
+    auto modified = fSourceModified;
+    auto source = fSource;
+    auto sourceSize = fSourceSize;
+    auto build = !fLazy;
+    auto index = fLazy ? &fIndex : &fLineIndex;
+    fSnapshotFuture = QtConcurrent::run( [ path, modified, source, sourceSize, build, index ]()
+    {
+        if ( build )
+        {
+            OutlineScanner scanner( source, sourceSize );
+            index->build( scanner );
+        }
+        auto hash = OutlineSnapshot::hashSource( source, sourceSize );
+        if ( !OutlineSnapshot::write( path, hash, sourceSize, modified, *index ) )
+            qWarning() << "Could not write the outline snapshot" << path;
+    } );
+}
+
+void TreeModel::saveSnapshotState()
+{
+    if ( fSnapshotPath.isEmpty() || fLoading )
+        return;
+
+    fSnapshotFuture.waitForFinished();
+    OutlineSnapshot::writeShownCounts( fSnapshotPath, shownCounts() );
+}
+
+// Every item that shows children, parents before their children. Only shown
+// subtrees are walked, the index gives the line of each shown child by skipping
+// over its previous siblings' subtrees. Without an index there is nothing to save.
+OutlineSnapshot::ShownCounts TreeModel::shownCounts() const
+{
+    OutlineSnapshot::ShownCounts retVal;
+    auto && index = fLazy ? fIndex : fLineIndex;
+    if ( index.isEmpty() )
+        return retVal;
+
+    QVector< QPair< TreeItem *, int > > pending;
+    pending.append( qMakePair( rootItem, -1 ) );
+    while ( !pending.isEmpty() )
+    {
+        auto item = pending.takeLast();
+        auto shown = item.first->shownChildCount();
+        if ( !shown )
+            continue;
+        retVal << qMakePair( item.second, shown );
+
+        auto first = pending.count();
+        auto line = index.firstChild( item.second );
+        for ( int ii = 0; ii < shown; ++ii )
+        {
+            pending.append( qMakePair( item.first->child( ii ), line ) );
+            line = index.nextSibling( line );
+        }
+        std::reverse( pending.begin() + first, pending.end() );
+    }
+    return retVal;
+}
+
+// Inside the reset, so the counts are set without insert notifications
+void TreeModel::restoreShownCounts( const OutlineSnapshot::ShownCounts & shownCounts )
+{
+    QHash< int, TreeItem * > items;
+    items.insert( -1, rootItem );
+    for ( auto && shown : shownCounts )
+    {
+        auto item = items.value( shown.first );
+        if ( !item )
+            continue;
+
+        auto count = qMin( shown.second, totalChildCount( item ) );
+        if ( item->childCount() < count )
+            materializeChildren( item, count );
+        item->setShownChildCount( count );
+        for ( int ii = 0; ii < count; ++ii )
+            items.insert( item->child( ii )->lineIndex(), item->child( ii ) );
+    }
+}
+
+// The state of one reload, the new tree is built aside in its own arena and
+// only the rows that are new are copied out of it. A lazy model indexes the new
+// text and creates new items only where the old tree has them.
+struct TreeModel::Reload
+{
+    struct Parent
+    {
+        TreeItem * oldItem;
+        TreeItem * newItem;
+        bool allShown; // every old child was shown, so the new ones are too
+    };
+
+    const char * source{ nullptr }; // the new text
+    qint64 sourceSize{ 0 };
+    OutlineIndex index; // of the new text, lazy models only
+    Arena arena;
+    StringTable strings;
+    QHash< const TreeItem *, TreeItem * > matched; // new item to the old item kept in its place
+    QVector< Parent > parents; // matched pairs that had children, parents first
+    QVector< TreeItem * > changed; // kept items whose text differs
+    int firstRootRow{ std::numeric_limits< int >::max() }; // the shown top level rows numbered from here on changed
+};
+
+void TreeModel::reload( const QByteArray & data )
+{
+    if ( !rootItem || fLoading )
+    {
+        load( data );
+        return;
+    }
+    reloadSource( nullptr, data, data.constData(), data.size(), QString() );
+}
+
+bool TreeModel::reloadFile( const QString & path )
+{
+    if ( !rootItem || fLoading )
+        return loadFile( path );
+
+    auto file = std::make_unique< QFile >( path );
+    if ( !file->open( QIODevice::ReadOnly ) )
+        return false;
+
+    auto size = file->size();
+    auto mapped = ( size > 0 ) ? file->map( 0, size ) : nullptr;
+    if ( mapped )
+        reloadSource( std::move( file ), QByteArray(), reinterpret_cast< const char * >( mapped ), size, path );
+    else
+    {
+        auto data = file->readAll();
+        reloadSource( nullptr, data, data.constData(), data.size(), path );
+    }
+    return true;
+}
+
+// Removals are signalled while every item still reads the old source, then the
+// kept items are pointed at the new one and the insertions and changed rows follow.
+// A view never sees an item whose text is in the other source.
+// A fully parsed model parses the new text and compares every item, a lazy one
+// only indexes it and compares the items it had created, the rest are created
+// from the new index when fetched and the model stays lazy. The signals and the
+// view's work are linear in the change. Removed items go back to the arena.
+void TreeModel::reloadSource( std::unique_ptr< QFile > file, const QByteArray & data, const char * source, qint64 sourceSize, const QString & path )
+{
+    fLoadTimer.start();
+    stopSearchIndex();
+    fSnapshotFuture.waitForFinished();
+
+    Reload state;
+    state.source = source;
+    state.sourceSize = sourceSize;
+    auto newRoot = TreeItem::createRoot( state.arena );
+    OutlineScanner scanner( source, sourceSize );
+    if ( fLazy )
+        state.index.build( scanner );
+    else
+        setupModelData( scanner, newRoot, state.arena, state.strings );
+
+    reloadRemoved( state, newRoot );
+
+    for ( auto pos = state.matched.cbegin(); pos != state.matched.cend(); ++pos )
+        pos.value()->assignData( pos.key() );
+    fSourceFile = std::move( file );
+    fSourceData = data;
+    fSource = source;
+    fSourceSize = sourceSize;
+    fStrings = state.strings;
+    fIndex = std::move( state.index );
+    fLineIndex.clear();
+    fSnapshot.close();
+    fFromSnapshot = false;
+
+    for ( auto && parent : state.parents )
+        reloadInserted( state, parent.oldItem, parent.newItem, parent.allShown );
+
+    for ( auto && item : state.changed )
+    {
+        auto parent = item->parent();
+        if ( item->row() >= parent->shownChildCount() )
+            continue;
+        auto lastColumn = qMax( 0, columnCount( itemIndex( parent ) ) - 1 );
+        emit dataChanged( createIndex( item->row(), 0, item ), createIndex( item->row(), lastColumn, item ) );
+    }
+    if ( state.firstRootRow < rootItem->shownChildCount() )
+        emit dataChanged( index( state.firstRootRow, 0 ), index( rootItem->shownChildCount() - 1, 0 ) );
+
+    fSnapshotPath.clear();
+    if ( !path.isEmpty() && !fSnapshotDir.isEmpty() )
+    {
+        fSnapshotPath = snapshotPath( path );
+        fSourceModified = sourceModified( path );
+        writeSnapshot();
+    }
+
+    fStats.loaded( fLoadTimer.nsecsElapsed() );
+    emit reloaded();
+}
+
+// For each new child the row of the old child it keeps, or -1. Rows match on
+// the title and column count; the common head and tail are paired directly, the
+// middle keeps the longest run of title matches that is in order on both sides,
+// so only the rows that moved are removed and inserted.
+QVector< int > TreeModel::matchChildren( const Reload & state, TreeItem * oldItem, TreeItem * newItem ) const
+{
+    auto oldCount = oldItem->childCount();
+    auto newCount = newItem->childCount();
+    auto oldTitle = [ & ]( int row ) { return oldItem->child( row )->text( 0, fSource, fStrings ); };
+    auto newTitle = [ & ]( int row ) { return newItem->child( row )->text( 0, state.source, state.strings ); };
+    auto same = [ & ]( int oldRow, int newRow )
+    {
+        return ( oldItem->child( oldRow )->columnCount() == newItem->child( newRow )->columnCount() ) && ( oldTitle( oldRow ) == newTitle( newRow ) );
+    };
+
+    QVector< int > retVal( newCount, -1 );
+    int head = 0;
+    for ( ; ( head < oldCount ) && ( head < newCount ) && same( head, head ); ++head )
+        retVal[ head ] = head;
+    int tail = 0;
+    for ( ; ( tail < oldCount - head ) && ( tail < newCount - head ) && same( oldCount - 1 - tail, newCount - 1 - tail ); ++tail )
+        retVal[ newCount - 1 - tail ] = oldCount - 1 - tail;
+
+    struct Candidates
+    {
+        QVector< int > rows; // ascending
+        int next{ 0 };
+    };
+    QHash< QString, Candidates > candidates;
+    for ( int row = head; row < newCount - tail; ++row )
+        candidates[ newTitle( row ) ].rows << row;
+
+    // the k-th old row with a title is the candidate for the k-th new row with it
+    QVector< QPair< int, int > > pairs; // ( old row, new row ), in old row order
+    for ( int row = head; row < oldCount - tail; ++row )
+    {
+        auto pos = candidates.find( oldTitle( row ) );
+        if ( ( pos == candidates.end() ) || ( pos.value().next == pos.value().rows.count() ) )
+            continue;
+        auto newRow = pos.value().rows[ pos.value().next++ ];
+        if ( oldItem->child( row )->columnCount() == newItem->child( newRow )->columnCount() )
+            pairs.append( qMakePair( row, newRow ) );
+    }
+
+    // patience sorting, ends[ k ] is the pair ending the lowest increasing run of k + 1 pairs
+    QVector< int > ends;
+    QVector< int > previous( pairs.count(), -1 );
+    for ( int ii = 0; ii < pairs.count(); ++ii )
+    {
+        auto pos = std::lower_bound( ends.begin(), ends.end(), pairs[ ii ].second, [ & ]( int end, int newRow ) { return pairs[ end ].second < newRow; } ) - ends.begin();
+        if ( pos > 0 )
+            previous[ ii ] = ends[ pos - 1 ];
+        if ( pos == ends.count() )
+            ends.append( ii );
+        else
+            ends[ pos ] = ii;
+    }
+    for ( int ii = ends.isEmpty() ? -1 : ends.back(); ii >= 0; ii = previous[ ii ] )
+        retVal[ pairs[ ii ].second ] = pairs[ ii ].first;
+    return retVal;
+}
+
+// Pre-order over the matched pairs, removing the old children without a match.
+// A lazy parent is compared on the children it has created, against as many new
+// ones plus the number added, so its children stay a prefix of the new index;
+// rows that moved further down are created again when fetched. A parent without
+// children created is left to the new index.
+void TreeModel::reloadRemoved( Reload & state, TreeItem * newRoot )
+{
+    QVector< QPair< TreeItem *, TreeItem * > > pending;
+    pending.append( qMakePair( rootItem, newRoot ) );
+    while ( !pending.isEmpty() )
+    {
+        auto oldItem = pending.last().first;
+        auto newItem = pending.last().second;
+        pending.removeLast();
+
+        auto oldTotal = totalChildCount( oldItem );
+        auto shown = oldItem->shownChildCount();
+        if ( fLazy )
+        {
+            if ( !oldItem->childCount() )
+                continue;
+            auto newTotal = state.index.childCount( newItem->lineIndex() );
+            auto count = qMin( newTotal, oldItem->childCount() + qMax( 0, newTotal - oldTotal ) );
+            materialize( state.index, state.source, state.sourceSize, state.arena, state.strings, newItem, count );
+        }
+        state.parents.append( { oldItem, newItem, shown && ( shown == oldTotal ) } );
+        reloadChildren( state, oldItem, newItem, pending );
+    }
+}
+
+// the matched children are added to pending, in reverse so they come off it in order
+void TreeModel::reloadChildren( Reload & state, TreeItem * oldItem, TreeItem * newItem, QVector< QPair< TreeItem *, TreeItem * > > & pending )
+{
+    auto matches = matchChildren( state, oldItem, newItem );
+    QVector< bool > kept( oldItem->childCount(), false );
+    QVector< QPair< TreeItem *, TreeItem * > > children;
+    for ( int row = 0; row < matches.count(); ++row )
+    {
+        if ( matches[ row ] < 0 )
+            continue;
+        kept[ matches[ row ] ] = true;
+        children.append( qMakePair( oldItem->child( matches[ row ] ), newItem->child( row ) ) );
+    }
+
+    // back to front so the runs before keep their rows
+    for ( int end = oldItem->childCount(); end > 0; )
+    {
+        if ( kept[ end - 1 ] )
+        {
+            --end;
+            continue;
+        }
+        int start = end - 1;
+        while ( ( start > 0 ) && !kept[ start - 1 ] )
+            --start;
+        removeChildren( state, oldItem, start, end - start );
+        end = start;
+    }
+
+    for ( auto && child : children )
+    {
+        state.matched.insert( child.second, child.first );
+        for ( int ii = 0; ii < child.first->columnCount(); ++ii )
+        {
+            if ( child.first->text( ii, fSource, fStrings ) != child.second->text( ii, state.source, state.strings ) )
+            {
+                state.changed << child.first;
+                break;
+            }
+        }
+    }
+    for ( int ii = children.count() - 1; ii >= 0; --ii )
+        pending.append( children[ ii ] );
+}
+
+// The old children are now the kept ones in order, the new ones go in between
+void TreeModel::reloadInserted( Reload & state, TreeItem * oldItem, TreeItem * newItem, bool allShown )
+{
+    for ( int row = 0; row < newItem->childCount(); )
+    {
+        if ( state.matched.contains( newItem->child( row ) ) )
+        {
+            ++row;
+            continue;
+        }
+        int start = row;
+        QVector< TreeItem * > items;
+        for ( ; ( row < newItem->childCount() ) && !state.matched.contains( newItem->child( row ) ); ++row )
+            items << copySubtree( newItem->child( row ), oldItem );
+        insertChildren( state, oldItem, start, items, allShown );
+    }
+}
+
+// rows past the shown count were never seen by a view and go silently
+void TreeModel::removeChildren( Reload & state, TreeItem * item, int row, int count )
+{
+    auto shown = item->shownChildCount();
+    auto shownRemoved = qBound( 0, shown - row, count );
+    if ( shownRemoved )
+        beginRemoveRows( itemIndex( item ), row, row + shownRemoved - 1 );
+    item->removeChildren( fArena, row, count );
+    if ( !shownRemoved )
+        return;
+
+    item->setShownChildCount( shown - shownRemoved );
+    endRemoveRows();
+    if ( item == rootItem )
+        state.firstRootRow = qMin( state.firstRootRow, row );
+}
+
+// New rows inside the shown ones, or after them when every child was shown, are
+// shown, the others wait for fetchMore
+void TreeModel::insertChildren( Reload & state, TreeItem * item, int row, const QVector< TreeItem * > & items, bool allShown )
+{
+    auto shown = item->shownChildCount();
+    bool show = ( row < shown ) || allShown;
+    if ( !show )
+    {
+        item->insertChildren( fArena, row, items.constData(), items.count() );
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    beginInsertRows( itemIndex( item ), row, row + items.count() - 1 );
+    item->insertChildren( fArena, row, items.constData(), items.count() );
+    item->setShownChildCount( shown + items.count() );
+    endInsertRows();
+    fStats.rowsInserted( items.count(), timer.nsecsElapsed() );
+    if ( item == rootItem )
+        state.firstRootRow = qMin( state.firstRootRow, row );
+}
+
+// into the model's arena, nothing of it is shown yet
+TreeItem * TreeModel::copySubtree( TreeItem * item, TreeItem * parent )
+{
+    auto retVal = TreeItem::copy( fArena, item, parent );
+    QVector< QPair< TreeItem *, TreeItem * > > pending; // ( item, its copy )
+    pending.append( qMakePair( item, retVal ) );
+    while ( !pending.isEmpty() )
+    {
+        auto curr = pending.takeLast();
+        curr.second->reserveChildren( fArena, curr.first->childCount() );
+        for ( int ii = 0; ii < curr.first->childCount(); ++ii )
+        {
+            auto child = TreeItem::copy( fArena, curr.first->child( ii ), curr.second );
+            curr.second->appendChild( fArena, child );
+            pending.append( qMakePair( curr.first->child( ii ), child ) );
+        }
+    }
+    return retVal;
+}
+
+QModelIndex TreeModel::itemIndex( TreeItem * item ) const
+{
+    if ( !item || ( item == rootItem ) )
+        return QModelIndex();
+    return createIndex( item->row(), 0, item );
+}
+
+void TreeModel::setSource( const QByteArray & data )
+{
+    fSourceData = data;
+    fSource = fSourceData.constData();
+    fSourceSize = fSourceData.size();
+}
+
+// Every load replaces the whole tree, the items point into the old source so
+// it is released only after they are gone. The reset is finished by parseSource.
+void TreeModel::resetModelData()
+{
+    stopLoad();
+    stopSearchIndex();
+    fSnapshotFuture.waitForFinished();
+    auto previousSnapshot = fSnapshotPath;
+    auto previousShown = previousSnapshot.isEmpty() ? OutlineSnapshot::ShownCounts() : shownCounts();
+
+    beginResetModel();
+    rootItem = nullptr;
+    fArena.clear();
+    fStrings.clear();
+    fLoadArena.reset();
+    fLoadArenaBytes = 0;
+    fLoadStrings.reset();
+    rootItem = createRootItem();
+    fSourceFile.reset();
+    fSourceData.clear();
+    fSource = nullptr;
+    fSourceSize = 0;
+    fIndex.clear();
+    fLineIndex.clear();
+    fLazy = false;
+    fSnapshot.close();
+    fSnapshotPath.clear();
+    fFromSnapshot = false;
+    fFetchPolicy.reset();
+
+    // after the mapping is gone, the file is rewritten in place
+    if ( !previousSnapshot.isEmpty() )
+        OutlineSnapshot::writeShownCounts( previousSnapshot, previousShown );
+}
+
+// eBackground parses on a worker thread; completed top level subtrees are appended
+// to the root on the GUI thread in batches, so rows already shown stay usable.
+void TreeModel::parseSource( ELoadMode mode )
+{
+    fLoadTimer.start();
+    if ( mode == ELoadMode::eImmediate )
+    {
+        OutlineScanner scanner( fSource, fSourceSize );
+        setupModelData( scanner, rootItem, fArena, fStrings );
+        fStats.loaded( fLoadTimer.nsecsElapsed() );
+        endResetModel();
+        return;
+    }
+    if ( mode == ELoadMode::eParallel )
+    {
+        parseParallel();
+        fStats.loaded( fLoadTimer.nsecsElapsed() );
+        endResetModel();
+        return;
+    }
+    if ( mode == ELoadMode::eLazy )
+    {
+        OutlineScanner scanner( fSource, fSourceSize );
+        fIndex.build( scanner );
+        fLazy = true;
+        fStats.loaded( fLoadTimer.nsecsElapsed() );
+        endResetModel();
+        return;
+    }
+    endResetModel();
+
+    fCancelLoad = false;
+    fLoading = true;
+    auto generation = ++fLoadGeneration;
+    auto root = rootItem;
+    auto source = fSource;
+    auto sourceSize = fSourceSize;
+    fLoadArena = std::make_unique< Arena >();
+    fLoadStrings = std::make_unique< StringTable >();
+    auto arena = fLoadArena.get();
+    auto strings = fLoadStrings.get();
+    fLoadFuture = QtConcurrent::run( [ this, source, sourceSize, root, arena, strings, generation ]()
+    {
+        OutlineScanner scanner( source, sourceSize );
+        auto totalBytes = scanner.size();
+
+        QList< TreeItem * > batch;
+        TreeItem * pending = nullptr; // still receiving children until the next top level line
+        int publishedStrings = 0;
+        QElapsedTimer sincePublish;
+        sincePublish.start();
+        auto publish = [ & ]( qint64 bytesParsed )
+        {
+            auto newStrings = strings->stringsFrom( publishedStrings );
+            auto stats = strings->stats();
+            auto arenaBytes = arena->bytesUsed();
+            publishedStrings = strings->count();
+            QMetaObject::invokeMethod( this, [ this, generation, batch, newStrings, stats, arenaBytes, bytesParsed, totalBytes ]()
+            {
+                if ( generation == fLoadGeneration )
+                    fLoadArenaBytes = arenaBytes;
+                publishTopLevelItems( generation, batch, newStrings, stats );
+                if ( generation == fLoadGeneration )
+                    emit loadProgress( bytesParsed, totalBytes );
+            }, Qt::QueuedConnection );
+            batch.clear();
+            sincePublish.restart();
+        };
+
+        setupModelData( scanner, root, *arena, *strings, [ & ]( TreeItem * item, qint64 offset )
+        {
+            if ( pending )
+                batch << pending;
+            pending = item;
+            if ( fCancelLoad )
+                return false;
+            if ( ( batch.count() >= kPublishBatchSize ) || ( !batch.isEmpty() && ( sincePublish.elapsed() >= kPublishIntervalMS ) ) )
+                publish( offset );
+            return true;
+        } );
+
+        if ( pending )
+            batch << pending;
+        if ( fCancelLoad )
+            return;
+        publish( totalBytes );
+        QMetaObject::invokeMethod( this, [ this, generation ]() { finishLoad( generation ); }, Qt::QueuedConnection );
+    } );
+}
+
+// Top level subtrees do not depend on each other, so each chunk of them is
+// parsed into its own root, arena and string table. The chunks are then merged
+// in order, which also numbers the top level rows as the serial parse does.
+void TreeModel::parseParallel()
+{
+    auto chunkCount = qMin( QThread::idealThreadCount() * kChunksPerThread, static_cast< int >( qMin< qint64 >( fSourceSize / kMinChunkBytes, std::numeric_limits< int >::max() ) ) );
+    auto boundaries = topLevelBoundaries( fSource, fSourceSize, qMax( 1, chunkCount ) );
+
+    struct Chunk
+    {
+        qint64 begin{ 0 };
+        qint64 end{ 0 };
+        Arena arena;
+        StringTable strings;
+        TreeItem * root{ nullptr };
+        int stringBase{ 0 };
+    };
+    std::vector< Chunk > chunks( boundaries.count() - 1 );
+    for ( int ii = 0; ii < boundaries.count() - 1; ++ii )
+    {
+        chunks[ ii ].begin = boundaries[ ii ];
+        chunks[ ii ].end = boundaries[ ii + 1 ];
+    }
+
+    auto source = fSource;
+    QtConcurrent::blockingMap( chunks, [ this, source ]( Chunk & chunk )
+    {
+        chunk.root = TreeItem::createRoot( chunk.arena );
+        OutlineScanner scanner( source, chunk.begin, chunk.end );
+        setupModelData( scanner, chunk.root, chunk.arena, chunk.strings );
+    } );
+
+    for ( auto && chunk : chunks )
+        chunk.stringBase = fStrings.merge( chunk.strings );
+    QtConcurrent::blockingMap( chunks, []( Chunk & chunk )
+    {
+        if ( !chunk.stringBase || !chunk.strings.count() )
+            return;
+        QVector< TreeItem * > pending;
+        pending.append( chunk.root );
+        while ( !pending.isEmpty() )
+        {
+            auto item = pending.takeLast();
+            item->rebaseStrings( chunk.stringBase );
+            for ( int ii = 0; ii < item->childCount(); ++ii )
+                pending.append( item->child( ii ) );
+        }
+    } );
+
+    int topLevelCount = 0;
+    for ( auto && chunk : chunks )
+        topLevelCount += chunk.root->childCount();
+    rootItem->reserveChildren( fArena, topLevelCount );
+    for ( auto && chunk : chunks )
+    {
+        rootItem->adoptChildren( fArena, chunk.root );
+        fArena.absorb( chunk.arena );
+    }
+}
+
+void TreeModel::cancelLoad()
+{
+    if ( !fLoading )
+        return;
+
+    fCancelLoad = true;
+    ++fLoadGeneration; // anything still queued from the worker is discarded
+    fLoading = false;
+    emit loadFinished( true );
+}
+
+void TreeModel::stopLoad()
+{
+    cancelLoad();
+    fLoadFuture.waitForFinished();
+}
+
+void TreeModel::publishTopLevelItems( int generation, const QList< TreeItem * > & items, const QVector< QString > & strings, const StringTable::Stats & stats )
+{
+    // stale items are left in the load arena, which goes with the next reset
+    if ( generation != fLoadGeneration )
+        return;
+
+    // ids handed out by the worker match, fStrings only ever grows from it in this mode
+    fStrings.adopt( strings, stats );
+
+    // the new children stay hidden until fetched, only top up an unfilled viewport
+    for ( auto && item : items )
+        rootItem->appendChild( fArena, item );
+    if ( rootItem->shownChildCount() < fFetchPolicy.viewportRows() )
+        fetchMore( QModelIndex() );
+}
+
+void TreeModel::finishLoad( int generation )
+{
+    if ( generation != fLoadGeneration )
+        return;
+
+    fLoading = false;
+    fStats.loaded( fLoadTimer.nsecsElapsed() );
+    emit loadFinished( false );
+}
+
+// A worker of the current generation that already finished built the index,
+// its queued callback just has not run yet
+void TreeModel::buildSearchIndex()
+{
+    if ( fSearchIndexReady || fSearchFuture.isRunning() )
+        return;
+
+    if ( ( fSearchFutureGeneration == fSearchGeneration ) && fSearchFuture.isFinished() )
+    {
+        fSearchIndexReady = true;
+        emit searchIndexReady();
+        return;
+    }
+
+    fCancelSearch = false;
+    auto generation = ++fSearchGeneration;
+    fSearchFutureGeneration = generation;
+    auto source = fSource;
+    auto sourceSize = fSourceSize;
+    fSearchFuture = QtConcurrent::run( [ this, source, sourceSize, generation ]()
+    {
+        OutlineScanner scanner( source, sourceSize );
+        if ( !fSearchIndex.build( scanner, &fCancelSearch ) )
+            return;
+        QMetaObject::invokeMethod( this, [ this, generation ]()
+        {
+            if ( ( generation != fSearchGeneration ) || fSearchIndexReady )
+                return;
+            fSearchIndexReady = true;
+            emit searchIndexReady();
+        }, Qt::QueuedConnection );
+    } );
+}
+
+void TreeModel::stopSearchIndex()
+{
+    fCancelSearch = true;
+    fSearchFuture.waitForFinished();
+    ++fSearchGeneration;
+    fSearchIndex.clear();
+    fSearchIndexReady = false;
+}
+
+// same text as TreeItem::data, top level lines are numbered by their row
+QVariant TreeModel::lineData( int line, int column ) const
+{
+    if ( !fSearchIndexReady || ( line < 0 ) || ( line >= fSearchIndex.lineCount() ) )
+        return QVariant();
+
+    auto text = fSearchIndex.text( line, column );
+    if ( text.isNull() )
+        return QVariant();
+    if ( ( column == 0 ) && ( fSearchIndex.parent( line ) < 0 ) )
+        text += ": " + QString::number( fSearchIndex.row( line ) );
+    return text;
+}
+
+// Never waits for the worker, until the index is ready this starts it and
+// finds nothing, search again on searchIndexReady
+QList< QVector< int > > TreeModel::search( const QString & text, int maxResults )
+{
+    QList< QVector< int > > retVal;
+    buildSearchIndex();
+    if ( !fSearchIndexReady )
+        return retVal;
+
+    for ( auto && line : fSearchIndex.find( text, maxResults ) )
+        retVal << fSearchIndex.path( line );
+    return retVal;
+}
+
+// Each row on the path is made visible by growing its parent's shown count to
+// include it, siblings after it stay unfetched. Rows of the background loader
+// that have not been published yet cannot be revealed.
+QModelIndex TreeModel::reveal( const QVector< int > & path )
+{
+    QModelIndex retVal;
+    auto item = rootItem;
+    for ( auto && row : path )
+    {
+        if ( !item || ( row < 0 ) || ( row >= totalChildCount( item ) ) )
+            return QModelIndex();
+
+        showChildren( retVal, item, row + 1 );
+        item = item->child( row );
+        if ( !item )
+            return QModelIndex();
+        retVal = createIndex( row, 0, item );
+    }
+    return retVal;
+}
+
+void TreeModel::showChildren( const QModelIndex & parent, TreeItem * item, int count )
+{
+    int currCount = item->shownChildCount();
+    if ( currCount >= count )
+        return;
+
+    if ( fLazy )
+        materializeChildren( item, count );
+    count = qMin( count, item->childCount() );
+    if ( currCount >= count )
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+    beginInsertRows( parent, currCount, count - 1 );
+    item->setShownChildCount( count );
+    endInsertRows();
+    fStats.rowsInserted( count - currCount, timer.nsecsElapsed() );
+}
+
+TreeItem * TreeModel::createRootItem()
+{
+    return TreeItem::createRoot( fArena );
+}
+
 TreeModel::~TreeModel()
 {
-    delete rootItem;
+    stopLoad();
+    stopSearchIndex();
+    saveSnapshotState();
+}
+
+qint64 TreeModel::itemBytes() const
+{
+    return fArena.bytesUsed() + fLoadArenaBytes;
 }
 
 TreeItem * TreeModel::getItem( const QModelIndex & index ) const
@@ -32,7 +978,10 @@ TreeItem * TreeModel::getItem( const QModelIndex & index ) const
 
 int TreeModel::columnCount( const QModelIndex & parent ) const
 {
+    fStats.count( ModelStats::eColumnCount );
     auto item = getItem( parent );
+    if ( item == rootItem )
+        return kHeaderCount;
     if ( item )
         return item->columnCount();
     return 0;
@@ -40,6 +989,7 @@ int TreeModel::columnCount( const QModelIndex & parent ) const
 
 QVariant TreeModel::data( const QModelIndex & index, int role ) const
 {
+    fStats.count( ModelStats::eData );
     if ( !index.isValid() )
         return QVariant();
 
@@ -50,7 +1000,7 @@ QVariant TreeModel::data( const QModelIndex & index, int role ) const
     if ( !item )
         return QVariant();
 
-    return item->data( index.column() );
+    return item->data( index.column(), fSource, fStrings );
 }
 Qt::ItemFlags TreeModel::flags( const QModelIndex & index ) const
 {
@@ -62,64 +1012,166 @@ Qt::ItemFlags TreeModel::flags( const QModelIndex & index ) const
 QVariant TreeModel::headerData( int section, Qt::Orientation orientation,
                                 int role ) const
 {
-    if ( orientation == Qt::Horizontal && role == Qt::DisplayRole )
-        return rootItem->data( section );
+    if ( orientation == Qt::Horizontal && role == Qt::DisplayRole && section >= 0 && section < kHeaderCount )
+        return QString( kHeaders[ section ] );
 
     return QVariant();
 }
 
-void TreeModel::setCurrentChildCount( TreeItem * item, int count )
+int TreeModel::totalChildCount( TreeItem * item ) const
 {
-    itemToChildShownCount[ item ] = count;
+    if ( fLazy )
+        return fIndex.childCount( item->lineIndex() );
+    return item->childCount();
 }
 
-int TreeModel::getCurrentChildCount( TreeItem * item, bool * cached ) const
+// Creates the children of a lazily loaded item from the line index until it has count of them
+void TreeModel::materializeChildren( TreeItem * item, int count )
 {
-    auto it = itemToChildShownCount.find( item );
-    if ( cached )
-        *cached = false;
-    if ( it != itemToChildShownCount.end() )
-    {
-        if ( cached )
-            *cached = true;
-        int count = it->second;
-        return count;
-    }
-    return 0;
+    materialize( fIndex, fSource, fSourceSize, fArena, fStrings, item, count );
 }
 
 bool TreeModel::canFetchMore( const QModelIndex & parent ) const
 {
+    fStats.count( ModelStats::eCanFetchMore );
     auto item = getItem( parent );
     if ( item )
-    {
-        int currCount = getCurrentChildCount( item, nullptr );
-        bool retVal = currCount < item->childCount();
-        return retVal;
-    }
+        return item->shownChildCount() < totalChildCount( item );
     return false;
 }
 
 void TreeModel::fetchMore( const QModelIndex & parent )
 {
+    fStats.count( ModelStats::eFetchMore );
     auto item = getItem( parent );
     if ( !item )
         return;
 
-    int currCount = getCurrentChildCount( item, nullptr );
-    int remainder = item->childCount() - currCount;
-    int itemsToFetch = qMin( 1, remainder );
+    int currCount = item->shownChildCount();
+    int remainder = totalChildCount( item ) - currCount;
+    int itemsToFetch = fFetchPolicy.batchSize( reinterpret_cast< quintptr >( item ), remainder );
     if ( itemsToFetch <= 0 )
         return;
 
+    if ( fLazy )
+        materializeChildren( item, currCount + itemsToFetch );
+
+    QElapsedTimer timer;
+    timer.start();
     beginInsertRows( parent, currCount, currCount + itemsToFetch - 1 );
-    setCurrentChildCount( item, currCount + itemsToFetch );
+    item->setShownChildCount( currCount + itemsToFetch );
     endInsertRows();
+    auto nsecs = timer.nsecsElapsed();
+    fFetchPolicy.batchFetched( itemsToFetch, nsecs );
+    fStats.rowsInserted( itemsToFetch, nsecs );
+}
+
+qint64 TreeModel::residentBytes() const
+{
+    return fLazy ? ( fArena.bytesUsed() - fArena.bytesReleased() ) : 0;
+}
+
+// The descendants of the removed rows are hidden as well so a fetch shows them
+// from the start again, Qt invalidates persistent indexes into the whole subtree
+int TreeModel::evictRows( const QModelIndex & parent, int keepRows )
+{
+    auto item = getItem( parent );
+    keepRows = qMax( 0, keepRows );
+    if ( !fLazy || !item || ( keepRows >= item->shownChildCount() ) || fLoading )
+        return 0;
+
+    auto retVal = item->shownChildCount() - keepRows;
+    beginRemoveRows( parent, keepRows, item->shownChildCount() - 1 );
+
+    QVector< TreeItem * > pending;
+    for ( int ii = keepRows; ii < item->shownChildCount(); ++ii )
+        pending.append( item->child( ii ) );
+    while ( !pending.isEmpty() )
+    {
+        auto curr = pending.takeLast();
+        for ( int ii = 0; ii < curr->shownChildCount(); ++ii )
+            pending.append( curr->child( ii ) );
+        curr->setShownChildCount( 0 );
+    }
+    item->setShownChildCount( keepRows );
+    item->releaseChildren( fArena, keepRows );
+
+    endRemoveRows();
+    return retVal;
+}
+
+// Shows every child down to the given depth. Only the parents whose rows a view
+// already has get an insert transaction, the rows inserted under them are new to
+// the view so their own children are shown inside it without signals. Existing
+// rows keep their place, so the selection and current index survive.
+void TreeModel::fetchSubtree( const QModelIndex & parent, int levels )
+{
+    auto item = getItem( parent );
+    if ( !item || ( levels == 0 ) )
+        return;
+
+    QVector< QPair< TreeItem *, int > > pending; // shown to the view, with the levels left below them
+    pending.append( qMakePair( item, levels ) );
+    while ( !pending.isEmpty() )
+    {
+        auto curr = pending.takeLast();
+        auto shown = curr.first->shownChildCount();
+        auto total = totalChildCount( curr.first );
+        auto childLevels = ( curr.second < 0 ) ? curr.second : ( curr.second - 1 );
+        if ( shown < total )
+        {
+            QElapsedTimer timer;
+            timer.start();
+            beginInsertRows( itemIndex( curr.first ), shown, total - 1 );
+            if ( fLazy && ( curr.first->childCount() < total ) )
+                materializeChildren( curr.first, total );
+            curr.first->setShownChildCount( total );
+            qint64 revealed = total - shown;
+            for ( int ii = shown; ii < total; ++ii )
+                revealed += showDescendants( curr.first->child( ii ), childLevels );
+            endInsertRows();
+            fStats.rowsInserted( static_cast< int >( qMin< qint64 >( revealed, std::numeric_limits< int >::max() ) ), timer.nsecsElapsed() );
+        }
+
+        if ( childLevels == 0 )
+            continue;
+        for ( int ii = 0; ii < shown; ++ii )
+            pending.append( qMakePair( curr.first->child( ii ), childLevels ) );
+    }
+}
+
+// Inside the insert of item's row, the rows below it have never been seen by a
+// view. Returns the number of rows shown.
+qint64 TreeModel::showDescendants( TreeItem * item, int levels )
+{
+    qint64 retVal = 0;
+    if ( levels == 0 )
+        return retVal;
+
+    QVector< QPair< TreeItem *, int > > pending;
+    pending.append( qMakePair( item, levels ) );
+    while ( !pending.isEmpty() )
+    {
+        auto curr = pending.takeLast();
+        auto total = totalChildCount( curr.first );
+        if ( fLazy && ( curr.first->childCount() < total ) )
+            materializeChildren( curr.first, total );
+        curr.first->setShownChildCount( total );
+        retVal += total;
+
+        if ( curr.second == 1 )
+            continue;
+        auto childLevels = ( curr.second < 0 ) ? curr.second : ( curr.second - 1 );
+        for ( int ii = 0; ii < total; ++ii )
+            pending.append( qMakePair( curr.first->child( ii ), childLevels ) );
+    }
+    return retVal;
 }
 
 //! [8]
 int TreeModel::rowCount( const QModelIndex & parent ) const
 {
+    fStats.count( ModelStats::eRowCount );
     if ( parent.column() > 0 )
         return 0;
 
@@ -127,15 +1179,12 @@ int TreeModel::rowCount( const QModelIndex & parent ) const
     if ( !parentItem )
         return 0;
 
-    bool cached = false;
-    auto count = getCurrentChildCount( parentItem, &cached );
-    if ( cached )
-        return count;
-    return 0;
+    return parentItem->shownChildCount();
 }
 
 QModelIndex TreeModel::index( int row, int column, const QModelIndex & parent ) const
 {
+    fStats.count( ModelStats::eIndex );
     if ( !hasIndex( row, column, parent ) )
         return QModelIndex();
 
@@ -152,6 +1201,7 @@ QModelIndex TreeModel::index( int row, int column, const QModelIndex & parent )
 
 QModelIndex TreeModel::parent( const QModelIndex & index ) const
 {
+    fStats.count( ModelStats::eParent );
     if ( !index.isValid() )
         return QModelIndex();
 
@@ -167,50 +1217,34 @@ QModelIndex TreeModel::parent( const QModelIndex & index ) const
     return createIndex( parentItem->row(), 0, parentItem );
 }
 
-void TreeModel::setupModelData( const QStringList & lines, QList< TreeItem * > & parentStack )
+void TreeModel::setupModelData( OutlineScanner & scanner, TreeItem * root, Arena & arena, StringTable & strings, const TopLevelSink & topLevelSink )
 {
-    Q_ASSERT( !parentStack.isEmpty() );
-    int prevDepth = -1;
-    int ii = 0; 
-    TreeItem * prevItem = parentStack.back();
-    int topParentNum = 0;
-    for( auto && currLine : lines )
+    // parentStack[ depth ] is the parent of a line at that depth
+    QVarLengthArray< TreeItem *, 32 > parentStack;
+    parentStack.append( root );
+    while ( scanner.next() )
     {
-        auto columns = currLine.split( "\t", Qt::KeepEmptyParts );
-        int depth = 0;
-        while( !columns.isEmpty() && columns[ 0 ].isEmpty() )
-        {
-            depth++;
-            columns.pop_front();
-        }
-        columns.removeAll( QString() );
-        if ( columns.isEmpty() )
-            continue;
-        
-        if ( depth > prevDepth ) // new parent
-        {
-            parentStack.push_back( prevItem );
-        }
-        else if ( depth < prevDepth ) // pop parent
-        {
-            if ( parentStack.count() > 1 )
-                parentStack.pop_back();
-        }
+        // a line can be at most one level below the line before it
+        auto depth = qMin( scanner.depth(), parentStack.size() - 1 );
+        parentStack.resize( depth + 1 );
         auto parentItem = parentStack.back();
-        prevDepth = depth;
 
-        prevItem = new TreeItem( columns, parentItem );
-        if ( parentStack.count() <= 2 )
+        auto item = TreeItem::create( arena, strings, scanner.data(), scanner, parentItem );
+        parentStack.append( item );
+        if ( ( depth == 0 ) && topLevelSink )
         {
-            prevItem->addSuffix( topParentNum++ ); 
+            if ( !topLevelSink( item, scanner.lineOffset() ) )
+                return;
+            continue;
         }
 
-        parentItem->appendChild( prevItem );
+        parentItem->appendChild( arena, item );
     }
 }
 
 bool TreeModel::hasChildren( const QModelIndex & parent ) const
 {
+    fStats.count( ModelStats::eHasChildren );
     bool retVal = QAbstractItemModel::hasChildren( parent ) || canFetchMore( parent );
     return retVal;
 }
@@ -3,26 +3,27 @@
 #include <QAbstractItemModel>
 #include <QModelIndex>
 #include <QVariant>
-#include <QMainWindow>
-#include <QApplication>
-#include <map>
-#include <QTreeView>
+#include <QFuture>
+#include <QElapsedTimer>
 
-class MainWindow : public QMainWindow
-{
-    Q_OBJECT
-private:
-public:
-    MainWindow(QWidget *parent = NULL);
-    virtual ~MainWindow();
+#include <atomic>
+#include <functional>
+#include <memory>
 
-private:
-    QTreeView * fView;
-};
+#include "fetchpolicy.h"
+#include "modelstats.h"
+#include "outlineindex.h"
+#include "arena.h"
+#include "stringtable.h"
+#include "searchindex.h"
+#include "outlinesnapshot.h"
+#include "evictablemodel.h"
 
 class TreeItem;
+class OutlineScanner;
+class QFile;
 
-class TreeModel : public QAbstractItemModel
+class TreeModel : public QAbstractItemModel, public EvictableModel
 {
     Q_OBJECT
 
@@ -30,7 +31,31 @@ public:
     TreeModel(QObject *parent = NULL);
     ~TreeModel();
 
-    void load( const QString & data );
+    enum class ELoadMode
+    {
+        eImmediate, // parse everything before returning
+        eBackground, // parse on a worker, top level subtrees appear as they finish
+        eLazy, // index the lines, create items when their parent is first fetched
+        eParallel // parse runs of top level subtrees on every core before returning
+    };
+
+    void load( const QByteArray & data, ELoadMode mode = ELoadMode::eImmediate );
+    bool loadFile( const QString & path, ELoadMode mode = ELoadMode::eImmediate );
+    bool isLoading() const { return fLoading; }
+
+    // Replace the source keeping the rows that are still there, matched by title
+    // under their matched parent. Only the differences are signalled, so shown
+    // counts and expansion survive. Falls back to a load while one is running.
+    void reload( const QByteArray & data );
+    bool reloadFile( const QString & path );
+
+    // loadFile writes a snapshot of the parsed outline there and reopens from it
+    // while the source is unchanged, empty (the default) turns snapshots off
+    void setSnapshotDirectory( const QString & dir ) { fSnapshotDir = dir; }
+    QString snapshotDirectory() const { return fSnapshotDir; }
+    bool isFromSnapshot() const { return fFromSnapshot; }
+    void saveSnapshotState(); // the shown counts, also done on every reset
+
     virtual QVariant data(const QModelIndex &index, int role) const override;
     virtual Qt::ItemFlags flags(const QModelIndex &index) const override;
     virtual QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
@@ -42,19 +67,113 @@ public:
 
     virtual bool canFetchMore( const QModelIndex & parent ) const override;
     virtual void fetchMore( const QModelIndex & parent ) override;
+    void fetchSubtree( const QModelIndex & parent = QModelIndex(), int levels = -1 ); // levels below parent, -1 for all
+
+    // Only lazily loaded items can be evicted, they are released for reuse and recreated
+    // from the line index when fetched again; a reload keeps a lazy model lazy. The other
+    // modes hold every item from the start, so they report nothing resident and evict nothing.
+    virtual qint64 residentBytes() const override;
+    virtual int evictRows( const QModelIndex & parent, int keepRows ) override;
+
+    FetchPolicy & fetchPolicy() { return fFetchPolicy; }
+    ModelStats & stats() { return fStats; }
+    qint64 itemBytes() const; // arena bytes held by the items of the current tree
+    StringTable::Stats internStats() const { return fStrings.stats(); }
+
+    // the index covers every line of the source, whether or not its item exists yet
+    void buildSearchIndex(); // in the background, searchIndexReady is emitted when done
+    bool isSearchIndexReady() const { return fSearchIndexReady; }
+    QList< QVector< int > > search( const QString & text, int maxResults = 1000 ); // row paths, empty until searchIndexReady
+    QModelIndex reveal( const QVector< int > & path ); // fetches just the rows on the path
+    const SearchIndex & searchIndex() const { return fSearchIndex; } // only complete once isSearchIndexReady
+    QVariant lineData( int line, int column ) const; // the display text of a line, whether or not its item exists
     //    void emitLayoutChangedSignal();
 
+public slots:
+    void cancelLoad();
+
+signals:
+    void loadProgress( qint64 bytesParsed, qint64 totalBytes );
+    void loadFinished( bool canceled );
+    void searchIndexReady();
+    void reloaded(); // the source changed without a reset, line based data such as the search index is rebuilt
+
 private:
-    void setupModelData(const QStringList &lines, QList< TreeItem * > & parentStack );
-    std::map<TreeItem*, int> itemToChildShownCount;
+    struct Reload;
+    using TopLevelSink = std::function< bool( TreeItem * item, qint64 offset ) >;
+    void setupModelData( OutlineScanner & scanner, TreeItem * root, Arena & arena, StringTable & strings, const TopLevelSink & topLevelSink = TopLevelSink() );
+    TreeItem * createRootItem();
+    void resetModelData();
+    void setSource( const QByteArray & data );
+    void parseSource( ELoadMode mode );
+    void parseParallel();
+    int totalChildCount( TreeItem * item ) const;
+    void materializeChildren( TreeItem * item, int count );
+    void stopLoad();
+    void publishTopLevelItems( int generation, const QList< TreeItem * > & items, const QVector< QString > & strings, const StringTable::Stats & stats );
+    void finishLoad( int generation );
+    void stopSearchIndex();
+    void showChildren( const QModelIndex & parent, TreeItem * item, int count );
+    qint64 showDescendants( TreeItem * item, int levels );
+    QString snapshotPath( const QString & sourcePath ) const;
+    bool snapshotMatches();
+    void loadSnapshot();
+    void writeSnapshot();
+    OutlineSnapshot::ShownCounts shownCounts() const;
+    void restoreShownCounts( const OutlineSnapshot::ShownCounts & shownCounts );
+    void reloadSource( std::unique_ptr< QFile > file, const QByteArray & data, const char * source, qint64 sourceSize, const QString & path );
+    QVector< int > matchChildren( const Reload & state, TreeItem * oldItem, TreeItem * newItem ) const;
+    void reloadRemoved( Reload & state, TreeItem * newRoot );
+    void reloadChildren( Reload & state, TreeItem * oldItem, TreeItem * newItem, QVector< QPair< TreeItem *, TreeItem * > > & pending );
+    void reloadInserted( Reload & state, TreeItem * oldItem, TreeItem * newItem, bool allShown );
+    void removeChildren( Reload & state, TreeItem * item, int row, int count );
+    void insertChildren( Reload & state, TreeItem * item, int row, const QVector< TreeItem * > & items, bool allShown );
+    TreeItem * copySubtree( TreeItem * item, TreeItem * parent );
+    QModelIndex itemIndex( TreeItem * item ) const;
+
     TreeItem *rootItem;
+    Arena fArena;
+    StringTable fStrings;
+    // owned by the eBackground worker, the strings are copied into fStrings as items are published
+    std::unique_ptr< Arena > fLoadArena;
+    qint64 fLoadArenaBytes{ 0 }; // its size as of the last published batch, the arena itself is the worker's
+    std::unique_ptr< StringTable > fLoadStrings;
+
+    // the text every TreeItem points into, either a mapped file or an in memory copy
+    std::unique_ptr< QFile > fSourceFile;
+    QByteArray fSourceData;
+    const char * fSource{ nullptr };
+    qint64 fSourceSize{ 0 };
+
+    OutlineIndex fIndex; // only built for ELoadMode::eLazy, or borrowed from fSnapshot
+    OutlineIndex fLineIndex; // the other modes, built by the snapshot writer, read only once fSnapshotFuture finished
+    bool fLazy{ false };
+
+    QString fSnapshotDir;
+    QString fSnapshotPath; // of the current source, empty when it has none
+    qint64 fSourceModified{ -1 }; // msecs since the epoch, -1 when the source has no time
+    OutlineSnapshot fSnapshot;
+    QFuture< void > fSnapshotFuture; // writing the snapshot, reads the source
+    bool fFromSnapshot{ false };
+
+    QFuture< void > fLoadFuture;
+    std::atomic< bool > fCancelLoad{ false };
+    int fLoadGeneration{ 0 };
+    bool fLoading{ false };
 
-    void setCurrentChildCount( TreeItem * item, int count );
-    int getCurrentChildCount(TreeItem* item, bool * cached ) const;
+    SearchIndex fSearchIndex; // written by its worker until fSearchFuture finishes
+    QFuture< void > fSearchFuture;
+    std::atomic< bool > fCancelSearch{ false };
+    int fSearchGeneration{ 0 };
+    int fSearchFutureGeneration{ -1 }; // the generation fSearchFuture builds
+    bool fSearchIndexReady{ false };
 
 protected:
     TreeItem * getItem( const QModelIndex & index ) const;
 
     bool fFetchingMore{false};
+    FetchPolicy fFetchPolicy;
+    mutable ModelStats fStats;
+    QElapsedTimer fLoadTimer;
 
 };
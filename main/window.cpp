@@ -50,6 +50,9 @@
 
 #include "window.h"
 #include "filelistmodel.h"
+#include "filelistfiltermodel.h"
+#include "scrollprefetcher.h"
+#include "rowevictor.h"
 
 #include <QtWidgets>
 #include <QAbstractItemModelTester>
@@ -57,17 +60,45 @@
 Window::Window(QWidget *parent)
     : QWidget(parent)
 {
-    FileListModel *model = new FileListModel(this);
+    model = new FileListModel(this);
+    // FETCHMORE_STATS collects from the first listing on, the context menu toggles it later
+    model->stats().setEnabled(qEnvironmentVariableIsSet("FETCHMORE_STATS"));
     new QAbstractItemModelTester( model, QAbstractItemModelTester::FailureReportingMode::Fatal, this );
 
     model->setDirPath(QLibraryInfo::location(QLibraryInfo::PrefixPath));
+    model->setDebounceInterval(150);
 
     QLabel *label = new QLabel(tr("&Directory:"));
     QLineEdit *lineEdit = new QLineEdit;
     label->setBuddy(lineEdit);
 
-    QListView *view = new QListView;
+    // filtering and sorting cover the whole listing, not just the fetched rows
+    filterModel = new FileListFilterModel(this);
+    filterModel->setSourceModel(model);
+    QLabel *filterLabel = new QLabel(tr("&Filter:"));
+    filterEdit = new QLineEdit;
+    filterLabel->setBuddy(filterEdit);
+    sortCheckBox = new QCheckBox(tr("&Sort by name"));
+
+    view = new QListView;
+    prefetcher = new ScrollPrefetcher(view);
     view->setModel(model);
+    view->installEventFilter(this);
+    // FETCHMORE_MEMORY_LIMIT_MB bounds the metadata held for rows far from the viewport
+    if (qEnvironmentVariableIsSet("FETCHMORE_MEMORY_LIMIT_MB")) {
+        evictor = new RowEvictor(view);
+        evictor->setMemoryLimit(qEnvironmentVariableIntValue("FETCHMORE_MEMORY_LIMIT_MB") * Q_INT64_C(1024 * 1024));
+    }
+
+    view->setContextMenuPolicy(Qt::ActionsContextMenu);
+    QAction *collectStatsAction = new QAction(tr("Collect Statistics"), view);
+    collectStatsAction->setCheckable(true);
+    collectStatsAction->setChecked(model->stats().isEnabled());
+    connect(collectStatsAction, &QAction::toggled, this, [this](bool checked) { model->stats().setEnabled(checked); });
+    view->addAction(collectStatsAction);
+    QAction *dumpStatsAction = new QAction(tr("Dump Statistics"), view);
+    connect(dumpStatsAction, &QAction::triggered, this, &Window::dumpStats);
+    view->addAction(dumpStatsAction);
 
     logViewer = new QTextBrowser(this);
     logViewer->setSizePolicy(QSizePolicy(QSizePolicy::Preferred, QSizePolicy::Preferred));
@@ -78,17 +109,69 @@ Window::Window(QWidget *parent)
             logViewer, &QTextEdit::clear);
     connect(model, &FileListModel::numberPopulated,
             this, &Window::updateLog);
+    connect(filterEdit, &QLineEdit::textChanged,
+            filterModel, &FileListFilterModel::setFilterText);
+    connect(filterEdit, &QLineEdit::textChanged,
+            this, &Window::updateViewModel);
+    connect(sortCheckBox, &QCheckBox::toggled, this, [this](bool checked) {
+        filterModel->sort(checked ? 0 : -1);
+        updateViewModel();
+    });
 
     QGridLayout *layout = new QGridLayout;
     layout->addWidget(label, 0, 0);
     layout->addWidget(lineEdit, 0, 1);
-    layout->addWidget(view, 1, 0, 1, 2);
-    layout->addWidget(logViewer, 2, 0, 1, 2);
+    layout->addWidget(filterLabel, 1, 0);
+    layout->addWidget(filterEdit, 1, 1);
+    layout->addWidget(sortCheckBox, 2, 1);
+    layout->addWidget(view, 3, 0, 1, 2);
+    layout->addWidget(logViewer, 4, 0, 1, 2);
 
     setLayout(layout);
     setWindowTitle(tr("Fetch More Example"));
 }
 
+Window::~Window()
+{
+    if (model->stats().isEnabled())
+        dumpStats();
+}
+
+QString Window::statsReport() const
+{
+    QString retVal = model->stats().dump("FileListModel");
+    retVal += QString("\nScrollPrefetcher\n  stalls: %1\n  prefetches: %2").arg(prefetcher->stallCount()).arg(prefetcher->prefetchCount());
+    if (evictor)
+        retVal += "\n" + evictor->report();
+    return retVal;
+}
+
+void Window::dumpStats()
+{
+    qDebug().noquote() << statsReport();
+}
+
+bool Window::eventFilter(QObject *obj, QEvent *event)
+{
+    if (obj == view && event->type() == QEvent::Resize) {
+        int rowHeight = qMax(view->fontMetrics().height(), view->sizeHintForRow(0));
+        model->fetchPolicy().setViewportHeight(view->viewport()->height(), rowHeight);
+        filterModel->fetchPolicy().setViewportHeight(view->viewport()->height(), rowHeight);
+    }
+    return QWidget::eventFilter(obj, event);
+}
+
+// The view shows the filter model only while it filters or sorts, so the plain
+// listing keeps its own fetch batches and row eviction
+void Window::updateViewModel()
+{
+    QAbstractItemModel *shown = model;
+    if (!filterEdit->text().isEmpty() || sortCheckBox->isChecked())
+        shown = filterModel;
+    if (view->model() != shown)
+        view->setModel(shown);
+}
+
 void Window::updateLog(int number)
 {
     logViewer->append(tr("%1 items added.").arg(number));
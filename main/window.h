@@ -55,7 +55,14 @@
 
 QT_BEGIN_NAMESPACE
 class QTextBrowser;
+class QListView;
+class QLineEdit;
+class QCheckBox;
 QT_END_NAMESPACE
+class FileListModel;
+class FileListFilterModel;
+class ScrollPrefetcher;
+class RowEvictor;
 
 class Window : public QWidget
 {
@@ -63,12 +70,26 @@ class Window : public QWidget
 
 public:
     Window(QWidget *parent = nullptr);
+    ~Window();
+
+    bool eventFilter(QObject *obj, QEvent *event) override;
+
+    QString statsReport() const; // model traffic, fetch batches, prefetch stalls and eviction counters as text
 
 public slots:
     void updateLog(int number);
+    void updateViewModel();
+    void dumpStats(); // statsReport() to the debug output
 
 private:
     QTextBrowser *logViewer;
+    QListView *view;
+    FileListModel *model;
+    FileListFilterModel *filterModel;
+    QLineEdit *filterEdit;
+    QCheckBox *sortCheckBox;
+    ScrollPrefetcher *prefetcher;
+    RowEvictor *evictor = nullptr;
 };
 
 #endif // WINDOW_H